@@ -1,16 +1,65 @@
-#include <clocale>
-#include <codecvt>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /**
  * In big project srand can be done in a lot of places so it had better to have an alternative.
  */
 #define SPEEDUP_GENERATOR_BY_DEDICATED_CALL_OF_SEED_RANDOM 0
 
+/**
+ * Benchmarks are not a part of the usual demo, they take a lot of time and memory.
+ */
+#ifndef RANDOM_STRING_GENERATOR_BENCHMARKS
+#define RANDOM_STRING_GENERATOR_BENCHMARKS 0
+#endif
+
 template<typename Container>
 using IteratorCategoryOf =
   typename std::iterator_traits<typename Container::iterator>::iterator_category;
@@ -21,125 +70,4250 @@ using HaveRandomAccessIterator = std::is_base_of<
   IteratorCategoryOf<Container>>;
 
 /**
- * Base implementation of class which will be reused in the helpers below.
+ * Resolution of the probability inside of the alias table, coins are 32 bits, so even very rare symbols keep their
+ * probability. RAND_MAX can be only 32767 on some platforms, so coins from rand functions are made by AliasCoin().
+ */
+constexpr uint64_t kAliasResolution = uint64_t{1} << 32;
+
+/**
+ * Builds Walker/Vose alias table, so any discrete distribution can be sampled with two uniform random numbers:
+ * column = rand(count), and result is column if AliasCoin(rand) < thresholds[column] otherwise aliases[column].
+ * @note There are raw pointers to be able to keep a lot of tables in one flat array.
+ * @param weights not negative, at least one should be positive
+ * @param count
+ * @param thresholds out, count values
+ * @param aliases out, count values
+ */
+inline void BuildAliasTable(double const *weights, size_t count, uint32_t *thresholds, uint32_t *aliases)
+{
+  double total = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!(weights[i] >= 0) || weights[i] == std::numeric_limits<double>::infinity()) {
+      throw std::invalid_argument("weights should be finite and not negative");
+    }
+    total += weights[i];
+  }
+  if (!(total > 0)) {
+    throw std::invalid_argument("at least one weight should be positive");
+  }
+
+  std::vector<double> scaled(count);
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+  for (size_t i = 0; i < count; i++) {
+    scaled[i] = weights[i] * count / total;
+    (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+  }
+  while (!small.empty() && !large.empty()) {
+    auto less = small.back();
+    small.pop_back();
+    auto more = large.back();
+    thresholds[less] = static_cast<uint32_t>(std::min(scaled[less] * kAliasResolution + 0.5, double(kAliasResolution - 1)));
+    aliases[less] = more;
+    scaled[more] -= 1.0 - scaled[less];
+    if (scaled[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // What is left has probability 1 up to rounding errors.
+  for (auto rest : {&small, &large}) {
+    for (auto column : *rest) {
+      thresholds[column] = static_cast<uint32_t>(kAliasResolution - 1);
+      aliases[column] = column;
+    }
+  }
+}
+
+/**
+ * 32 bits coin for the alias table from a rand function, it is made of three draws of 15 bits.
+ * @param rand gives a number from [0, range)
+ * @return
+ */
+inline auto AliasCoin(std::function<size_t(size_t)> const &rand) -> uint32_t
+{
+  uint64_t coin = rand(1 << 15);
+  coin = (coin << 15) | rand(1 << 15);
+  coin = (coin << 15) | rand(1 << 15);
+  return static_cast<uint32_t>(coin >> 13);
+}
+
+/**
+ * Stateless mixer(finalizer of splitmix64), good enough to derive keys and seeds from counters.
+ * @param x
+ * @return
+ */
+inline auto SplitMix64(uint64_t x) noexcept -> uint64_t
+{
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+/**
+ * Built-in engine xoshiro256**, it is much faster than std::rand, it has 256 bits of state and gives 64 bits per call,
+ * so kernels can take a lot of symbols from one call instead of one symbol per call.
+ * @note There is not any operator() on purpose, otherwise it is silently convertible to std::function<void()>.
+ */
+class Xoshiro256
+{
+public:
+  /**
+   * State is filled by splitmix64 from the seed, as the authors of xoshiro recommend.
+   * @param seed
+   */
+  explicit Xoshiro256(uint64_t seed) noexcept
+  {
+    for (size_t i = 0; i < 4; i++) {
+      _state[i] = SplitMix64(seed + i * 0x9E3779B97F4A7C15ull);
+    }
+  }
+
+  /**
+   * @return 64 random bits
+   */
+  auto Next() noexcept -> uint64_t
+  {
+    auto result = Rotate(_state[1] * 5, 7) * 9;
+    auto t = _state[1] << 17;
+    _state[2] ^= _state[0];
+    _state[3] ^= _state[1];
+    _state[1] ^= _state[2];
+    _state[0] ^= _state[3];
+    _state[2] ^= t;
+    _state[3] = Rotate(_state[3], 45);
+    return result;
+  }
+
+  /**
+   * Unbiased random number from [0, range), Lemire's multiply and shift, division only in rare case of rejection.
+   * @param range should not be 0
+   * @return
+   */
+  auto Below(uint64_t range) noexcept -> uint64_t
+  {
+#if defined(__SIZEOF_INT128__)
+    auto product = static_cast<unsigned __int128>(Next()) * range;
+    if (static_cast<uint64_t>(product) < range) {
+      auto threshold = (0 - range) % range;
+      while (static_cast<uint64_t>(product) < threshold) {
+        product = static_cast<unsigned __int128>(Next()) * range;
+      }
+    }
+    return static_cast<uint64_t>(product >> 64);
+#else
+    auto threshold = (0 - range) % range;
+    for (;;) {
+      auto value = Next();
+      if (value >= threshold) {
+        return value % range;
+      }
+    }
+#endif
+  }
+
+  /**
+   * Engine of one shard: the stream of the seed is split into the parts of 2^192 numbers, shard i starts i long jumps
+   * after the beginning. So shards never overlap, and all processes and machines which know the seed give together
+   * the same output. Work inside of the shard is split by Jump(), 2^64 parts of 2^128 numbers fit into the shard.
+   * @param seed the same for all shards
+   * @param shardIndex should be less than shardCount
+   * @param shardCount
+   * @return
+   */
+  static auto ForShard(uint64_t seed, uint64_t shardIndex, uint64_t shardCount) -> Xoshiro256
+  {
+    if (shardIndex >= shardCount) {
+      throw std::invalid_argument("shardIndex should be less than shardCount");
+    }
+    Xoshiro256 result(seed);
+    for (uint64_t i = 0; i < shardIndex; i++) {
+      result.LongJump();
+    }
+    return result;
+  }
+
+  /**
+   * The same as 2^128 calls of Next(), for splitting of work between threads and chunks.
+   */
+  void Jump() noexcept
+  {
+    static constexpr uint64_t kJump[] = {0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull,
+                                         0x39ABDC4529B1661Cull};
+    Apply(kJump);
+  }
+
+  /**
+   * The same as 2^192 calls of Next(), for splitting of the stream between shards.
+   */
+  void LongJump() noexcept
+  {
+    static constexpr uint64_t kLongJump[] = {0x76E15D3EFEFDCBBFull, 0xC5004E441C522FB3ull, 0x77710069854EE241ull,
+                                             0x39109BB02ACBE635ull};
+    Apply(kLongJump);
+  }
+
+  /**
+   * State as kStateSize bytes, little endian, so it can be restored on any platform.
+   * @param out
+   */
+  void SaveState(unsigned char *out) const noexcept
+  {
+    for (size_t i = 0; i < 4; i++) {
+      for (size_t byte = 0; byte < 8; byte++) {
+        out[i * 8 + byte] = static_cast<unsigned char>(_state[i] >> (byte * 8));
+      }
+    }
+  }
+
+  /**
+   * @param in kStateSize bytes from SaveState()
+   */
+  void LoadState(unsigned char const *in)
+  {
+    uint64_t state[4] = {};
+    for (size_t i = 0; i < 4; i++) {
+      for (size_t byte = 0; byte < 8; byte++) {
+        state[i] |= uint64_t{in[i * 8 + byte]} << (byte * 8);
+      }
+    }
+    if ((state[0] | state[1] | state[2] | state[3]) == 0) {
+      throw std::invalid_argument("state of xoshiro256 can not be all zeros");
+    }
+    std::copy(state, state + 4, _state);
+  }
+
+  static constexpr size_t kStateSize = 32;
+
+private:
+  static auto Rotate(uint64_t x, int k) noexcept -> uint64_t
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  /**
+   * Jump by the polynomial of the jump, as in the reference implementation.
+   */
+  void Apply(uint64_t const (&polynomial)[4]) noexcept
+  {
+    uint64_t state[4] = {};
+    for (auto word : polynomial) {
+      for (int bit = 0; bit < 64; bit++) {
+        if (word & (uint64_t{1} << bit)) {
+          for (size_t i = 0; i < 4; i++) {
+            state[i] ^= _state[i];
+          }
+        }
+        Next();
+      }
+    }
+    std::copy(state, state + 4, _state);
+  }
+
+  uint64_t _state[4];
+};
+
+/**
+ * Inclusive range of symbols, to describe big alphabets without storing every symbol.
+ * @note Constructor takes only symbols, so {'a', 1.0} is still a weighted symbol and not a range.
+ * @tparam TChar
+ */
+template<typename TChar>
+struct CharsetRange
+{
+  template<typename TFirst,
+           typename TLast,
+           typename std::enable_if<std::is_same<TFirst, TChar>::value && std::is_same<TLast, TChar>::value>::type * = nullptr>
+  CharsetRange(TFirst firstSymbol, TLast lastSymbol) noexcept
+      : first{firstSymbol}, last{lastSymbol}
+  {
+  }
+
+  TChar first;
+  TChar last;
+};
+
+/**
+ * Sequence of symbols which is stored by ceil(log2(|charset|)) bits per symbol instead of a whole TChar, for example
+ * ACGT or hex take 4 and 2 times less memory and I/O than bytes. Symbols do not cross words, so for 3, 5, 6 and 7 bits
+ * the highest bits of every word are not used.
+ * @note Symbols are unpacked on demand by operator[], by the iterator of a View, or by blocks with Unpack.
  * @tparam TChar character can be different.
  */
 template<typename TChar>
-class RandomStringGeneratorBase
+class PackedSequenceBase
 {
 public:
+  class Iterator;
+  class View;
+
   /**
-   * Very efficient constructor which will almost do nothing, there is not any virtual tables, there is not any
-   * calculations in the body. May be it had better to add noexcept(I have added but should be checked if it will be
-   * available for all cases.
-   * @note This will be done more rarely than actual generate, and everything will be here like a configuration, to
-   * avoid do this every place.
-   * @param charset
-   * @param charsetSize
-   * @param seed provide any your own
+   * @param charset from 2 to 2^16 symbols
+   * @param size amount of symbols
    */
-  RandomStringGeneratorBase(
-    std::basic_string<TChar> charset,
-    std::function<void()> seed = []() { srand(time(nullptr)); },
-    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; }) noexcept
-      : _charset{std::move(charset)}, _seed{std::move(seed)}, _rand{std::move(rand)}
+  PackedSequenceBase(std::basic_string<TChar> charset, size_t size)
+      : _charset{std::move(charset)}, _size{size}
+  {
+    if (_charset.size() < 2 || _charset.size() > (size_t{1} << 16)) {
+      throw std::invalid_argument("packed charset should have from 2 to 65536 symbols");
+    }
+    while ((size_t{1} << _bits) < _charset.size()) {
+      _bits++;
+    }
+    _perWord = 64 / _bits;
+    _mask = (uint64_t{1} << _bits) - 1;
+    _words.resize((_size + _perWord - 1) / _perWord);
+  }
+
+  auto Size() const noexcept -> size_t
+  {
+    return _size;
+  }
+
+  auto BitsPerSymbol() const noexcept -> size_t
+  {
+    return _bits;
+  }
+
+  auto Charset() const noexcept -> std::basic_string<TChar> const &
+  {
+    return _charset;
+  }
+
+  /**
+   * Raw packed data, it can be written to a file as is, and filled directly by a generator.
+   * @return
+   */
+  auto Words() noexcept -> uint64_t *
+  {
+    return _words.data();
+  }
+
+  auto Words() const noexcept -> uint64_t const *
+  {
+    return _words.data();
+  }
+
+  auto WordCount() const noexcept -> size_t
+  {
+    return _words.size();
+  }
+
+  /**
+   * Index of the symbol in the charset.
+   * @param index
+   * @return
+   */
+  auto IndexAt(size_t index) const noexcept -> size_t
+  {
+    return static_cast<size_t>((_words[index / _perWord] >> ((index % _perWord) * _bits)) & _mask);
+  }
+
+  void SetIndexAt(size_t index, size_t value) noexcept
+  {
+    auto &word = _words[index / _perWord];
+    auto shift = (index % _perWord) * _bits;
+    word = (word & ~(_mask << shift)) | ((uint64_t{value} & _mask) << shift);
+  }
+
+  auto operator[](size_t index) const noexcept -> TChar
+  {
+    return _charset[IndexAt(index)];
+  }
+
+  /**
+   * Unpacking by whole words, the most common widths have the shift and mask as constants.
+   * @param first
+   * @param count
+   * @param out should have space for count symbols
+   */
+  void Unpack(size_t first, size_t count, TChar *out) const
+  {
+    switch (_bits) {
+      case 1:
+        UnpackFixed<1>(first, count, out);
+        break;
+      case 2:
+        UnpackFixed<2>(first, count, out);
+        break;
+      case 4:
+        UnpackFixed<4>(first, count, out);
+        break;
+      case 8:
+        UnpackFixed<8>(first, count, out);
+        break;
+      default:
+        for (size_t i = 0; i < count; i++) {
+          out[i] = (*this)[first + i];
+        }
+        break;
+    }
+  }
+
+  /**
+   * Helper for returning unpacked symbols in some container like vector or string.
+   * @tparam T
+   * @param first
+   * @param count
+   * @return
+   */
+  template<typename T>
+  auto Unpack(size_t first, size_t count) const -> T
+  {
+    T result(count, {});
+    Unpack(first, count, result.data());
+    return result;
+  }
+
+  auto Slice(size_t first, size_t count) const noexcept -> View
+  {
+    return View(this, first, count);
+  }
+
+  auto begin() const noexcept -> Iterator
+  {
+    return Iterator(this, 0);
+  }
+
+  auto end() const noexcept -> Iterator
+  {
+    return Iterator(this, _size);
+  }
+
+  /**
+   * Lazy iterator, every symbol is unpacked only when it is dereferenced. It returns symbols by value, so it is only an
+   * input iterator, forward iterators should return references.
+   */
+  class Iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = TChar;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = TChar;
+
+    Iterator() = default;
+
+    Iterator(PackedSequenceBase const *sequence, size_t index) noexcept
+        : _sequence{sequence}, _index{index}
+    {
+    }
+
+    auto operator*() const noexcept -> TChar
+    {
+      return (*_sequence)[_index];
+    }
+
+    auto operator++() noexcept -> Iterator &
+    {
+      _index++;
+      return *this;
+    }
+
+    auto operator++(int) noexcept -> Iterator
+    {
+      auto previous = *this;
+      _index++;
+      return previous;
+    }
+
+    auto operator==(Iterator const &other) const noexcept -> bool
+    {
+      return _index == other._index;
+    }
+
+    auto operator!=(Iterator const &other) const noexcept -> bool
+    {
+      return _index != other._index;
+    }
+
+  private:
+    PackedSequenceBase const *_sequence{};
+    size_t _index{};
+  };
+
+  /**
+   * Part of the sequence without copying.
+   */
+  class View
+  {
+  public:
+    View(PackedSequenceBase const *sequence, size_t first, size_t count) noexcept
+        : _sequence{sequence}, _first{first}, _count{count}
+    {
+    }
+
+    auto size() const noexcept -> size_t
+    {
+      return _count;
+    }
+
+    auto operator[](size_t index) const noexcept -> TChar
+    {
+      return (*_sequence)[_first + index];
+    }
+
+    void Unpack(TChar *out) const
+    {
+      _sequence->Unpack(_first, _count, out);
+    }
+
+    auto begin() const noexcept -> Iterator
+    {
+      return Iterator(_sequence, _first);
+    }
+
+    auto end() const noexcept -> Iterator
+    {
+      return Iterator(_sequence, _first + _count);
+    }
+
+  private:
+    PackedSequenceBase const *_sequence;
+    size_t _first;
+    size_t _count;
+  };
+
+private:
+  template<size_t bits>
+  void UnpackFixed(size_t first, size_t count, TChar *out) const
+  {
+    constexpr size_t kPerWord = 64 / bits;
+    constexpr uint64_t kMask = (uint64_t{1} << bits) - 1;
+    auto const *charset = _charset.data();
+    size_t i = 0;
+    // Head up to the word boundary, then whole words, then the tail.
+    for (; i < count && (first + i) % kPerWord != 0; i++) {
+      out[i] = (*this)[first + i];
+    }
+    for (; i + kPerWord <= count; i += kPerWord) {
+      auto word = _words[(first + i) / kPerWord];
+      for (size_t j = 0; j < kPerWord; j++) {
+        out[i + j] = charset[(word >> (j * bits)) & kMask];
+      }
+    }
+    for (; i < count; i++) {
+      out[i] = (*this)[first + i];
+    }
+  }
+
+  std::basic_string<TChar> _charset;
+  size_t _size;
+  size_t _bits{1};
+  size_t _perWord;
+  uint64_t _mask;
+  std::vector<uint64_t> _words;
+};
+
+using PackedSequence = PackedSequenceBase<char>;
+using PackedSequenceW = PackedSequenceBase<wchar_t>;
+
+/**
+ * Simple pool of threads for background jobs, tasks are taken in the order of submission.
+ */
+class ThreadPool
+{
+public:
+  explicit ThreadPool(size_t threads)
+  {
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); i++) {
+      _threads.emplace_back([this]() { Work(); });
+    }
+  }
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stopping = true;
+    }
+    _wakeup.notify_all();
+    for (auto &thread : _threads) {
+      thread.join();
+    }
+  }
+
+  void Submit(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _tasks.push_back(std::move(task));
+    }
+    _wakeup.notify_one();
+  }
+
+  /**
+   * Pool with a thread per hardware thread, it is created on the first usage.
+   * @return
+   */
+  static auto Shared() -> ThreadPool &
+  {
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+  }
+
+private:
+  void Work()
+  {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wakeup.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+        if (_tasks.empty()) {
+          return;
+        }
+        task = std::move(_tasks.front());
+        _tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _wakeup;
+  std::deque<std::function<void()>> _tasks;
+  bool _stopping{};
+  std::vector<std::thread> _threads;
+};
+
+/**
+ * Handle of a background generation: the future gives the amount of produced symbols when all chunks are finished,
+ * progress can be polled at any time and cancellation is cooperative, chunks check it between small steps.
+ * @note Copies of the handle refer to the same job. After cancellation the output is only partially written.
+ */
+class GenerationJob
+{
+public:
+  /**
+   * Submission of chunks to the pool.
+   * @param total amount of symbols of the whole job
+   * @param chunks amount of tasks
+   * @param task generates one chunk, checks Cancelled() and reports by AddProgress()
+   * @param pool
+   */
+  GenerationJob(size_t total, size_t chunks, std::function<void(size_t, GenerationJob const &)> task,
+                ThreadPool &pool = ThreadPool::Shared())
+      : _state{std::make_shared<State>()}
+  {
+    _state->total = total;
+    _state->chunksLeft = chunks;
+    _future = _state->promise.get_future().share();
+    if (chunks == 0) {
+      _state->promise.set_value(0);
+      return;
+    }
+    auto shared = std::make_shared<std::function<void(size_t, GenerationJob const &)>>(std::move(task));
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+      pool.Submit([job = *this, shared, chunk]() {
+        try {
+          (*shared)(chunk, job);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(job._state->mutex);
+          if (!job._state->error) {
+            job._state->error = std::current_exception();
+          }
+        }
+        if (--job._state->chunksLeft == 0) {
+          if (job._state->error) {
+            job._state->promise.set_exception(job._state->error);
+          } else {
+            job._state->promise.set_value(job._state->produced);
+          }
+        }
+      });
+    }
+  }
+
+  /**
+   * @return future of the amount of produced symbols
+   */
+  auto Future() const -> std::shared_future<size_t>
+  {
+    return _future;
+  }
+
+  /**
+   * Waiting for the end of the job.
+   * @return amount of produced symbols
+   */
+  auto Wait() const -> size_t
+  {
+    return _future.get();
+  }
+
+  auto Produced() const noexcept -> size_t
+  {
+    return _state->produced;
+  }
+
+  auto Total() const noexcept -> size_t
+  {
+    return _state->total;
+  }
+
+  /**
+   * Chunks stop at the next step, already produced symbols stay in the output.
+   */
+  void Cancel() noexcept
+  {
+    _state->cancelled = true;
+  }
+
+  auto Cancelled() const noexcept -> bool
+  {
+    return _state->cancelled.load(std::memory_order_relaxed);
+  }
+
+  void AddProgress(size_t symbols) const noexcept
+  {
+    _state->produced.fetch_add(symbols, std::memory_order_relaxed);
+  }
+
+private:
+  struct State
+  {
+    size_t total{};
+    std::atomic<size_t> produced{};
+    std::atomic<size_t> chunksLeft{};
+    std::atomic<bool> cancelled{};
+    std::promise<size_t> promise;
+    std::mutex mutex;
+    std::exception_ptr error;
+  };
+
+  std::shared_ptr<State> _state;
+  std::shared_future<size_t> _future;
+};
+
+/**
+ * How the workers of parallel generation are placed on the machine.
+ */
+enum class AffinityPolicy
+{
+  // Threads are not pinned, the scheduler decides, it is the default.
+  None,
+  // Work is split by NUMA nodes, threads of every node are pinned to its CPUs, so pages of the output are first
+  // touched and allocated on the node which writes them.
+  PerNode,
+};
+
+/**
+ * When big outputs are written by non-temporal stores, they go to memory around the cache and do not evict the
+ * working set of other code on the core.
+ */
+enum class StreamingStores
+{
+  // Only outputs from the threshold.
+  Auto,
+  Always,
+  Never,
+};
+
+/**
+ * CPUs of NUMA nodes, they are read from /sys on Linux, elsewhere it is one node with all hardware threads.
+ */
+struct NumaTopology
+{
+  std::vector<std::vector<int>> nodes;
+
+  static auto Detect() -> NumaTopology
+  {
+    NumaTopology result;
+#if defined(__linux__)
+    // Numbers of nodes can have gaps, so only the online ones are read.
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodes;
+    std::getline(online, nodes);
+    for (auto node : ParseCpuList(nodes)) {
+      std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+      std::string list;
+      if (!std::getline(file, list)) {
+        continue;
+      }
+      auto cpus = ParseCpuList(list);
+      if (!cpus.empty()) {
+        result.nodes.push_back(std::move(cpus));
+      }
+    }
+#endif
+    if (result.nodes.empty()) {
+      result.nodes.emplace_back();
+      for (unsigned cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++) {
+        result.nodes.back().push_back(static_cast<int>(cpu));
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @param list in the kernel format like "0-3,8-11", the same format is used for lists of nodes
+   * @return
+   */
+  static auto ParseCpuList(std::string const &list) -> std::vector<int>
+  {
+    std::vector<int> cpus;
+    size_t position = 0;
+    while (position < list.size() && std::isdigit(static_cast<unsigned char>(list[position]))) {
+      size_t used = 0;
+      auto first = std::stoi(list.substr(position), &used);
+      position += used;
+      auto last = first;
+      if (position < list.size() && list[position] == '-') {
+        last = std::stoi(list.substr(position + 1), &used);
+        position += used + 1;
+      }
+      for (auto cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+      if (position < list.size() && list[position] == ',') {
+        position++;
+      }
+    }
+    return cpus;
+  }
+
+  /**
+   * Pinning of the calling thread, it does nothing where it is not supported.
+   * @param cpus
+   * @return whether the thread is pinned
+   */
+  static auto PinThisThread(std::vector<int> const &cpus) noexcept -> bool
+  {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+  }
+};
+
+/**
+ * Base implementation of class which will be reused in the helpers below.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class RandomStringGeneratorBase
+{
+public:
+  /**
+   * Very efficient constructor which will almost do nothing, there is not any virtual tables, there is not any
+   * calculations in the body. May be it had better to add noexcept(I have added but should be checked if it will be
+   * available for all cases.
+   * @note This will be done more rarely than actual generate, and everything will be here like a configuration, to
+   * avoid do this every place. The only work is one pass over the charset to find out if it is a few contiguous ranges
+   * and comparison with a few standard alphabets, without any allocation.
+   * @param charset
+   * @param charsetSize
+   * @param seed provide any your own
+   */
+  RandomStringGeneratorBase(
+    std::basic_string<TChar> charset,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; }) noexcept
+      : _charset{std::move(charset)}, _seed{std::move(seed)}, _rand{std::move(rand)}, _symbolCount{_charset.size()}
+  {
+#if !SPEEDUP_GENERATOR_BY_DEDICATED_CALL_OF_SEED_RANDOM
+    // A lot of people thought that atomic very fast. In computers with 128 cores implementation which uses atomics
+    // can slow down compared to 32 cores etc. The problem is in the nature of atomic cpu core hardware implementation.
+    // So I have just shown that this is not a good idea but, it is helpful do not care about it some time.
+    static std::once_flag flag;
+    std::call_once(flag, [&]() {
+      // this every time passed by copy, so I do not see any problems to use & to avoid exercises around changing this
+      // in the future. The main fail of interviewers that = means everything copy from scope(only that one which was
+      // used in the lambda), and & everything will be copied by reference(it is not true, because this will be copied by value)
+      Seed();
+    });
+#endif
+    FindRanges();
+    DetectEncoding();
+  }
+
+  /**
+   * Helper for usage arrays and avoid doing size calculation on the client code side.
+   * @note due to C++ language allow to init an arrays with const char sequence pointer,
+   * you should understand that \0 will be in the end, and C++ can not care about it,
+   * so use for this purpose constructor which gets TChar const* instead.
+   * @param charsetArray
+   * @param seed
+   * @param rand
+   */
+  template<size_t size>
+  RandomStringGeneratorBase(
+    TChar const (&charsetArray)[size],
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : RandomStringGeneratorBase<TChar>(std::basic_string<TChar>(charsetArray, charsetArray + size),
+                                         std::move(seed),
+                                         std::move(rand))
+  {
+  }
+
+  /**
+   * Helper to use const strings.
+   * @tparam size
+   * @param charsetArray
+   * @param seed
+   * @param rand
+   */
+  RandomStringGeneratorBase(
+    TChar const *charsetString,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : RandomStringGeneratorBase<TChar>(std::basic_string<TChar>(charsetString),
+                                          std::move(seed),
+                                          std::move(rand))
+  {
+  }
+
+  /**
+   * Generic helper constructor for any kind of random access iterator containers.
+   * @tparam Container it can be std::vector or std::string for example
+   * @param charset
+   * @param seed
+   * @param rand
+   */
+  template<typename Container,
+           typename std::enable_if<HaveRandomAccessIterator<Container>::value>::type * = nullptr>
+  RandomStringGeneratorBase(
+    Container charset,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : RandomStringGeneratorBase<TChar>(std::basic_string<TChar>(charset.data(), charset.data() + charset.size()),
+                                         std::move(seed),
+                                         std::move(rand))
+  {
+  }
+
+  /**
+   * Weighted charset, every symbol will be generated with probability proportional to its weight. Much better than
+   * repeating of symbols in the charset, there is no any bloating and weights can be any.
+   * @note Sampling is O(1) for every symbol due to alias table.
+   * @param weightedCharset pairs of symbol and weight
+   * @param seed
+   * @param rand
+   */
+  RandomStringGeneratorBase(
+    std::vector<std::pair<TChar, double>> const &weightedCharset,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : RandomStringGeneratorBase<TChar>(SymbolsOf(weightedCharset), std::move(seed), std::move(rand))
+  {
+    std::vector<double> weights;
+    weights.reserve(weightedCharset.size());
+    for (auto const &item : weightedCharset) {
+      weights.push_back(item.second);
+    }
+    _aliasThresholds.resize(weights.size());
+    _aliases.resize(weights.size());
+    BuildAliasTable(weights.data(), weights.size(), _aliasThresholds.data(), _aliases.data());
+  }
+
+  /**
+   * Charset as a list of ranges, it is never materialized, so all of Unicode or a big CJK block takes O(ranges) memory
+   * instead of a string with every symbol. Ranges can be in any order and can overlap.
+   * @note Up to 4 ranges are mapped arithmetically, more ranges are mapped by a branchless binary search over prefix
+   * sums, which are small enough to stay in L1.
+   * @param ranges
+   * @param seed
+   * @param rand
+   */
+  RandomStringGeneratorBase(
+    std::vector<CharsetRange<TChar>> ranges,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : RandomStringGeneratorBase<TChar>(std::basic_string<TChar>(), std::move(seed), std::move(rand))
+  {
+    UseRanges(std::move(ranges));
+  }
+
+  /**
+   * Helper for returning result in some container like vector or string.
+   * @tparam T
+   * @param outSize
+   * @return
+   */
+  template<typename T>
+  auto get(size_t outSize) -> T
+  {
+    T result(outSize, {});
+    get(result.data(), result.size());
+    return result;
+  }
+
+  /**
+   * The same with a custom allocator, e.g. ArenaAllocator for huge pages.
+   * @tparam T
+   * @param outSize
+   * @param allocator
+   * @return
+   */
+  template<typename T, typename Allocator>
+  auto get(size_t outSize, Allocator const &allocator) -> T
+  {
+    T result(outSize, TChar{}, allocator);
+    get(result.data(), result.size());
+    return result;
+  }
+
+  /**
+   * Very efficient implementation but not very safe due to some preconditions should be checked on the client code side.
+   * @tparam TChar
+   * @param out
+   * @param outSize
+   */
+  void get(TChar *out, size_t outSize)
+  {
+    if (_engine && outSize <= kPoolMaxRequest) {
+      GetPooled(out, outSize);
+      return;
+    }
+    _lastShort = false;
+    if (_streaming == StreamingStores::Always ||
+        (_streaming == StreamingStores::Auto && outSize * sizeof(TChar) >= _streamingThreshold)) {
+      GetStreaming(out, outSize);
+      return;
+    }
+    GetDirect(out, outSize);
+  }
+
+  /**
+   * Control of non-temporal stores, by default they are used for outputs from kStreamingThreshold bytes, which are
+   * much bigger than the cache anyway.
+   * @param mode
+   * @param thresholdBytes for StreamingStores::Auto
+   */
+  void UseStreamingStores(StreamingStores mode, size_t thresholdBytes = kStreamingThreshold) noexcept
+  {
+    _streaming = mode;
+    _streamingThreshold = thresholdBytes;
+  }
+
+  /**
+   * @return how many times the pool of symbols for short requests was refilled
+   */
+  auto RefillCount() const noexcept -> size_t
+  {
+    return _refills;
+  }
+
+  /**
+   * Manual asking seeding.
+   */
+  void Seed()
+  {
+    _seed();
+  }
+
+  /**
+   * Built-in engine instead of seed and rand functions. There is not any call through std::function anymore, and
+   * charsets of standard encodings(hex, base32, base58, base64) and tiny charsets(2, 4 and 8 symbols) take a lot of
+   * symbols from every 64 bits.
+   * @param engine
+   */
+  void UseEngine(Xoshiro256 engine)
+  {
+    BuildByteGroups();
+    _engine = engine;
+    _pool.clear();
+    _poolNext = 0;
+    _lastShort = false;
+  }
+
+  auto HasEngine() const noexcept -> bool
+  {
+    return _engine.has_value();
+  }
+
+  /**
+   * @return copy of the built-in engine in its current state
+   */
+  auto Engine() const -> Xoshiro256
+  {
+    if (!_engine) {
+      throw std::logic_error("the built-in engine is not used");
+    }
+    return *_engine;
+  }
+
+  /**
+   * Snapshot of the position in the stream of the built-in engine, so a long job can be stopped and resumed exactly
+   * where it was. The format is the magic "RSGS", a version byte, the state of the engine, 2 bytes of the amount of
+   * not yet used symbols of the pool for short requests and a byte of flags. If there are such symbols, the state of
+   * the engine before the last refill follows, and the pool is generated again by LoadState().
+   * @note Only the built-in engine can be saved, the state of std::rand and of custom functions is not accessible.
+   * @return compact binary form
+   */
+  auto SaveState() const -> std::string
+  {
+    if (!_engine) {
+      throw std::logic_error("only the state of the built-in engine can be saved, call UseEngine() first");
+    }
+    std::string result(kStateMagic, sizeof(kStateMagic));
+    result.push_back(static_cast<char>(kStateVersion));
+    unsigned char engine[Xoshiro256::kStateSize];
+    _engine->SaveState(engine);
+    result.append(reinterpret_cast<char const *>(engine), sizeof(engine));
+    auto unused = _pool.size() - _poolNext;
+    result.push_back(static_cast<char>(unused & 0xFF));
+    result.push_back(static_cast<char>(unused >> 8));
+    result.push_back(static_cast<char>(_lastShort ? kLastShortFlag : 0));
+    if (unused > 0) {
+      _poolEngine->SaveState(engine);
+      result.append(reinterpret_cast<char const *>(engine), sizeof(engine));
+    }
+    return result;
+  }
+
+  /**
+   * Restoring of the snapshot from SaveState(), the built-in engine is used after that.
+   * @param state
+   */
+  void LoadState(std::string_view state)
+  {
+    auto header = sizeof(kStateMagic) + 1 + Xoshiro256::kStateSize;
+    if (state.size() < header || state.substr(0, sizeof(kStateMagic)) != std::string_view(kStateMagic, sizeof(kStateMagic))) {
+      throw std::invalid_argument("state is not a snapshot of the generator");
+    }
+    if (static_cast<unsigned char>(state[sizeof(kStateMagic)]) != kStateVersion) {
+      throw std::invalid_argument("unsupported version of the snapshot");
+    }
+    if (state.size() < header + 3) {
+      throw std::invalid_argument("state is not a snapshot of the generator");
+    }
+    auto unused = static_cast<unsigned char>(state[header]) | size_t{static_cast<unsigned char>(state[header + 1])} << 8;
+    auto flags = static_cast<unsigned char>(state[header + 2]);
+    header += 3;
+    if (state.size() != header + (unused > 0 ? Xoshiro256::kStateSize : 0) || unused > kPoolSize) {
+      throw std::invalid_argument("state is not a snapshot of the generator");
+    }
+    auto engine = Xoshiro256(0);
+    engine.LoadState(reinterpret_cast<unsigned char const *>(state.data()) + sizeof(kStateMagic) + 1);
+    UseEngine(engine);
+    if (unused > 0) {
+      // Long requests could go after the refill, so the current engine is restored after the pool.
+      auto poolEngine = Xoshiro256(0);
+      poolEngine.LoadState(reinterpret_cast<unsigned char const *>(state.data()) + header);
+      _engine = poolEngine;
+      RefillPool();
+      _poolNext = _pool.size() - unused;
+      _engine = engine;
+    }
+    _lastShort = (flags & kLastShortFlag) != 0;
+  }
+
+  /**
+   * Parallel generation of a big output. Every thread takes a contiguous part, its engine is the engine of the
+   * generator after jumps, and the generator continues after all of them.
+   * @note With AffinityPolicy::PerNode parts are grouped by NUMA nodes and threads are pinned, so if out was not yet
+   * touched, every page is allocated on the node of the thread which writes it. Consumers should read it with the
+   * same split to keep the memory local.
+   * @param out
+   * @param outSize
+   * @param threads
+   * @param policy
+   */
+  void ParallelGenerate(TChar *out, size_t outSize, size_t threads = std::thread::hardware_concurrency(),
+                        AffinityPolicy policy = AffinityPolicy::None)
+  {
+    if (!_engine) {
+      throw std::logic_error("parallel generation needs the built-in engine, call UseEngine() first");
+    }
+    threads = std::max<size_t>(threads, 1);
+    auto topology = policy == AffinityPolicy::PerNode ? NumaTopology::Detect() : NumaTopology{};
+    std::vector<std::thread> workers;
+    for (size_t thread = 0; thread < threads; thread++) {
+      auto copy = *this;
+      copy.UseEngine(*_engine);
+      _engine->Jump();
+      auto begin = outSize / threads * thread + std::min(thread, outSize % threads);
+      auto size = outSize / threads + (thread < outSize % threads ? 1 : 0);
+      // Consecutive threads go to the same node, so every node has one contiguous part of the output.
+      std::vector<int> cpus;
+      if (!topology.nodes.empty()) {
+        cpus = topology.nodes[thread * topology.nodes.size() / threads];
+      }
+      workers.emplace_back([copy = std::move(copy), cpus = std::move(cpus), out, begin, size]() mutable {
+        if (!cpus.empty()) {
+          NumaTopology::PinThisThread(cpus);
+        }
+        copy.get(out + begin, size);
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  /**
+   * Parallel generation into not yet touched memory, so the first touch is done by the workers.
+   * @param outSize
+   * @param threads
+   * @param policy
+   * @return
+   */
+  auto ParallelGenerate(size_t outSize, size_t threads = std::thread::hardware_concurrency(),
+                        AffinityPolicy policy = AffinityPolicy::None) -> std::unique_ptr<TChar[]>
+  {
+    // Without () elements are not initialized, so big blocks stay untouched fresh pages.
+    std::unique_ptr<TChar[]> result(new TChar[outSize]);
+    ParallelGenerate(result.get(), outSize, threads, policy);
+    return result;
+  }
+
+  /**
+   * Background generation by the shared pool of threads, for outputs so big that the caller can not wait. The output
+   * is split into chunks, engine of every chunk is the engine of the generator after chunk jumps, and the generator
+   * continues after the last of them, so the next calls do not repeat the job.
+   * @note Only with the built-in engine, std::rand and custom functions are not thread safe.
+   * @param out should stay valid until the end of the job
+   * @param outSize
+   * @return handle of the job
+   */
+  auto GenerateAsync(TChar *out, size_t outSize) -> GenerationJob
+  {
+    if (!_engine) {
+      throw std::logic_error("background generation needs the built-in engine, call UseEngine() first");
+    }
+    auto chunks = (outSize + kAsyncChunk - 1) / kAsyncChunk;
+    auto engines = std::make_shared<std::vector<Xoshiro256>>();
+    engines->reserve(chunks);
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+      engines->push_back(*_engine);
+      _engine->Jump();
+    }
+    auto generator = std::make_shared<RandomStringGeneratorBase const>(*this);
+    return GenerationJob(outSize, chunks, [generator, engines, out, outSize](size_t chunk, GenerationJob const &job) {
+      auto copy = *generator;
+      copy.UseEngine((*engines)[chunk]);
+      auto end = std::min(outSize, (chunk + 1) * kAsyncChunk);
+      for (auto position = chunk * kAsyncChunk; position < end && !job.Cancelled(); position += kAsyncStep) {
+        auto count = std::min(kAsyncStep, end - position);
+        copy.get(out + position, count);
+        job.AddProgress(count);
+      }
+    });
+  }
+
+  /**
+   * Generation directly into the packed form. With the built-in engine and a power of two charset every word is just
+   * 64 random bits, there is not any charset lookup at all.
+   * @note Charset should be a string of symbols without weights.
+   * @param outSize amount of symbols
+   * @return
+   */
+  auto GetPacked(size_t outSize) -> PackedSequenceBase<TChar>
+  {
+    if (_charset.empty() || !_aliases.empty()) {
+      throw std::logic_error("packed generation needs a charset without weights");
+    }
+    PackedSequenceBase<TChar> result(_charset, outSize);
+    if (_engine && (_charset.size() & (_charset.size() - 1)) == 0) {
+      auto *words = result.Words();
+      for (size_t i = 0; i < result.WordCount(); i++) {
+        words[i] = _engine->Next();
+      }
+      return result;
+    }
+    for (size_t i = 0; i < outSize; i++) {
+      result.SetIndexAt(i, Index(_charset.size()));
+    }
+    return result;
+  }
+
+private:
+  /**
+   * Short requests are served from the pool, it is refilled by the bulk kernels at once, so the cost of dispatch and
+   * of the engine calls is shared by a lot of requests.
+   */
+  void GetPooled(TChar *out, size_t outSize)
+  {
+    // The first short request after UseEngine() is generated directly, e.g. a chunk of RandomStringSequence with
+    // its own engine would use only a few symbols of the whole pool.
+    if (!std::exchange(_lastShort, true) && _pool.size() == _poolNext) {
+      GetDirect(out, outSize);
+      return;
+    }
+    if (_pool.size() - _poolNext < outSize) {
+      auto rest = _pool.size() - _poolNext;
+      std::copy(_pool.begin() + _poolNext, _pool.end(), out);
+      out += rest;
+      outSize -= rest;
+      RefillPool();
+    }
+    std::copy(_pool.begin() + _poolNext, _pool.begin() + _poolNext + outSize, out);
+    _poolNext += outSize;
+  }
+
+  /**
+   * The engine before the refill is kept, so the snapshot has only it and the position in the pool.
+   */
+  void RefillPool()
+  {
+    _poolEngine = _engine;
+    _pool.resize(kPoolSize);
+    GetDirect(_pool.data(), _pool.size());
+    _poolNext = 0;
+    _refills++;
+  }
+
+  /**
+   * Symbols are generated into the staging block which stays in L1, and are copied to the output by non-temporal
+   * stores. Head and tail, which are not aligned to 16 bytes, are written as usual.
+   */
+  void GetStreaming(TChar *out, size_t outSize)
+  {
+#if defined(__SSE2__)
+    auto misalignment = reinterpret_cast<uintptr_t>(out) % 16;
+    auto head = std::min(outSize, misalignment == 0 ? 0 : (16 - misalignment) / sizeof(TChar));
+    GetDirect(out, head);
+    out += head;
+    outSize -= head;
+    alignas(16) TChar staging[kStagingBytes / sizeof(TChar)];
+    constexpr size_t kStagingSize = sizeof(staging) / sizeof(TChar);
+    while (outSize >= kStagingSize) {
+      GetDirect(staging, kStagingSize);
+      auto from = reinterpret_cast<__m128i const *>(staging);
+      auto to = reinterpret_cast<__m128i *>(out);
+      for (size_t i = 0; i < sizeof(staging) / 16; i++) {
+        _mm_stream_si128(to + i, _mm_load_si128(from + i));
+      }
+      out += kStagingSize;
+      outSize -= kStagingSize;
+    }
+    // Streaming stores are weakly ordered, the fence makes them visible before the usual stores after return.
+    _mm_sfence();
+#endif
+    GetDirect(out, outSize);
+  }
+
+  void GetDirect(TChar *out, size_t outSize)
+  {
+    if (!_aliases.empty()) {
+      GetWeighted(out, outSize);
+      return;
+    }
+    if (_engine && _encoding != Encoding::None) {
+      GetEncoded(out, outSize);
+      return;
+    }
+    if (_rangeCount > 0) {
+      GetByRanges(out, outSize);
+      return;
+    }
+    if (!_rangeFirsts.empty()) {
+      GetBySearch(out, outSize);
+      return;
+    }
+    if constexpr (sizeof(TChar) > 1) {
+      GetByBlocks(out, outSize);
+      return;
+    }
+    if (_engine) {
+      for (size_t i = 0; i < outSize; i++) {
+        out[i] = _charset[_engine->Below(_charset.size())];
+      }
+      return;
+    }
+    // This loop will be optimized, so should not be used any handwritten pointer tricks...
+    for (int i = 0; i < outSize; i++) {
+      out[i] = _charset[_rand(_charset.size())];
+    }
+  }
+
+  enum class Encoding
+  {
+    None,
+    Binary,
+    Quaternary,
+    Octal,
+    Hex,
+    Base32,
+    Base58,
+    Base64
+  };
+
+  static auto SymbolsOf(std::vector<std::pair<TChar, double>> const &weightedCharset) -> std::basic_string<TChar>
+  {
+    std::basic_string<TChar> symbols;
+    symbols.reserve(weightedCharset.size());
+    for (auto const &item : weightedCharset) {
+      symbols.push_back(item.first);
+    }
+    return symbols;
+  }
+
+  auto Index(size_t range) -> size_t
+  {
+    return _engine ? static_cast<size_t>(_engine->Below(range)) : _rand(range);
+  }
+
+  void GetWeighted(TChar *out, size_t outSize)
+  {
+    // Random numbers are taken by blocks, so the second loop has no calls inside and can be vectorized(gathers and
+    // blends with AVX2).
+    constexpr size_t kBlockSize = 256;
+    uint32_t columns[kBlockSize];
+    uint32_t coins[kBlockSize];
+    for (size_t done = 0; done < outSize; done += kBlockSize) {
+      auto count = std::min(kBlockSize, outSize - done);
+      for (size_t i = 0; i < count; i++) {
+        columns[i] = static_cast<uint32_t>(Index(_aliases.size()));
+        coins[i] = _engine ? static_cast<uint32_t>(_engine->Next() >> 32) : AliasCoin(_rand);
+      }
+      for (size_t i = 0; i < count; i++) {
+        auto column = columns[i];
+        out[done + i] = _charset[coins[i] < _aliasThresholds[column] ? column : _aliases[column]];
+      }
+    }
+  }
+
+  static auto CodeOf(TChar symbol) noexcept -> uint32_t
+  {
+    return static_cast<uint32_t>(static_cast<typename std::make_unsigned<TChar>::type>(symbol));
+  }
+
+  /**
+   * Charsets like 0-9a-z are a few contiguous ranges, symbol of such charset is index + offset of its range. All
+   * arithmetic is modulo 2^32, so offset of every next range is added as a difference to the previous one.
+   * @note Small tables are in L1 anyway and loading from them is not slower than compare and add(see the benchmark in
+   * main), so arithmetic is used only when the charset table is bigger than kMinArithmeticTableBytes.
+   */
+  void FindRanges() noexcept
+  {
+    static_assert(sizeof(TChar) <= sizeof(uint32_t), "symbols should fit in 32 bits");
+    _rangeCount = 0;
+    if (_charset.size() * sizeof(TChar) < kMinArithmeticTableBytes || _charset.size() > std::numeric_limits<uint32_t>::max()) {
+      return;
+    }
+    uint32_t previousOffset = 0;
+    for (size_t i = 0; i < _charset.size(); i++) {
+      if (i > 0 && CodeOf(_charset[i]) == CodeOf(_charset[i - 1]) + 1) {
+        continue;
+      }
+      if (_rangeCount == kMaxArithmeticRanges) {
+        _rangeCount = 0;
+        return;
+      }
+      auto offset = CodeOf(_charset[i]) - static_cast<uint32_t>(i);
+      _rangeBegins[_rangeCount] = static_cast<uint32_t>(i);
+      _rangeSteps[_rangeCount] = offset - previousOffset;
+      previousOffset = offset;
+      _rangeCount++;
+    }
+    for (auto k = _rangeCount; k < kMaxArithmeticRanges; k++) {
+      _rangeBegins[k] = std::numeric_limits<uint32_t>::max();
+      _rangeSteps[k] = 0;
+    }
+  }
+
+  void UseRanges(std::vector<CharsetRange<TChar>> ranges)
+  {
+    for (auto const &range : ranges) {
+      if (CodeOf(range.last) < CodeOf(range.first)) {
+        throw std::invalid_argument("range should not be reversed");
+      }
+    }
+    std::sort(ranges.begin(), ranges.end(), [](auto const &lhs, auto const &rhs) {
+      return CodeOf(lhs.first) < CodeOf(rhs.first);
+    });
+    std::vector<std::pair<uint32_t, uint32_t>> merged;
+    for (auto const &range : ranges) {
+      if (!merged.empty() && CodeOf(range.first) <= merged.back().second + 1) {
+        merged.back().second = std::max(merged.back().second, CodeOf(range.last));
+      } else {
+        merged.emplace_back(CodeOf(range.first), CodeOf(range.last));
+      }
+    }
+    if (merged.empty()) {
+      throw std::invalid_argument("charset should not be empty");
+    }
+
+    uint64_t symbolCount = 0;
+    for (auto const &range : merged) {
+      _rangeFirsts.push_back(range.first);
+      _rangePrefix.push_back(static_cast<uint32_t>(symbolCount));
+      symbolCount += uint64_t{range.second} - range.first + 1;
+    }
+    if (symbolCount > std::numeric_limits<uint32_t>::max()) {
+      throw std::invalid_argument("charset should have less than 2^32 symbols");
+    }
+    _symbolCount = static_cast<size_t>(symbolCount);
+
+    if (merged.size() <= kMaxArithmeticRanges) {
+      uint32_t previousOffset = 0;
+      for (size_t k = 0; k < kMaxArithmeticRanges; k++) {
+        auto used = k < merged.size();
+        auto offset = used ? _rangeFirsts[k] - _rangePrefix[k] : previousOffset;
+        _rangeBegins[k] = used ? _rangePrefix[k] : std::numeric_limits<uint32_t>::max();
+        _rangeSteps[k] = offset - previousOffset;
+        previousOffset = offset;
+      }
+      _rangeCount = merged.size();
+      _rangeFirsts.clear();
+      _rangePrefix.clear();
+    }
+  }
+
+  void GetBySearch(TChar *out, size_t outSize)
+  {
+    constexpr size_t kBlockSize = 256;
+    uint32_t indexes[kBlockSize];
+    TChar symbols[kBlockSize];
+    auto const *firsts = _rangeFirsts.data();
+    auto const *prefix = _rangePrefix.data();
+    for (size_t done = 0; done < outSize; done += kBlockSize) {
+      auto count = std::min(kBlockSize, outSize - done);
+      for (size_t i = 0; i < count; i++) {
+        indexes[i] = static_cast<uint32_t>(Index(_symbolCount));
+      }
+      for (size_t i = 0; i < count; i++) {
+        auto index = indexes[i];
+        // The last range which starts not after the index, without branches which can not be predicted.
+        size_t low = 0;
+        for (auto length = _rangeFirsts.size(); length > 1;) {
+          auto half = length / 2;
+          low = (prefix[low + half] <= index) ? low + half : low;
+          length -= half;
+        }
+        symbols[i] = static_cast<TChar>(firsts[low] + (index - prefix[low]));
+      }
+      std::copy(symbols, symbols + count, out + done);
+    }
+  }
+
+  void GetByRanges(TChar *out, size_t outSize)
+  {
+    // Compare and add for every range instead of loading from the charset, the loop is vectorized even for bytes,
+    // there are not any byte gathers in SIMD.
+    constexpr size_t kBlockSize = 256;
+    uint32_t indexes[kBlockSize];
+    TChar symbols[kBlockSize];
+    for (size_t done = 0; done < outSize; done += kBlockSize) {
+      auto count = std::min(kBlockSize, outSize - done);
+      for (size_t i = 0; i < count; i++) {
+        indexes[i] = static_cast<uint32_t>(Index(_symbolCount));
+      }
+      for (size_t i = 0; i < count; i++) {
+        auto index = indexes[i];
+        auto code = index + _rangeSteps[0];
+        for (size_t k = 1; k < kMaxArithmeticRanges; k++) {
+          code += _rangeSteps[k] & (0u - static_cast<uint32_t>(index >= _rangeBegins[k]));
+        }
+        symbols[i] = static_cast<TChar>(code);
+      }
+      std::copy(symbols, symbols + count, out + done);
+    }
+  }
+
+  void GetByBlocks(TChar *out, size_t outSize)
+  {
+    // Wide symbols are mapped from indexes by a separate loop without calls, which becomes gathers(vpgatherdd) when
+    // the build has AVX2 or AVX-512, see RANDOM_STRING_GENERATOR_NATIVE in CMakeLists.txt. Symbols are gathered into a
+    // local block, the output could alias the charset otherwise.
+    constexpr size_t kBlockSize = 256;
+    uint32_t indexes[kBlockSize];
+    TChar symbols[kBlockSize];
+    auto const *charset = _charset.data();
+    for (size_t done = 0; done < outSize; done += kBlockSize) {
+      auto count = std::min(kBlockSize, outSize - done);
+      for (size_t i = 0; i < count; i++) {
+        indexes[i] = static_cast<uint32_t>(Index(_charset.size()));
+      }
+      for (size_t i = 0; i < count; i++) {
+        symbols[i] = charset[indexes[i]];
+      }
+      std::copy(symbols, symbols + count, out + done);
+    }
+  }
+
+  void DetectEncoding()
+  {
+    // Alphabets of RFC 4648 and of Bitcoin base58.
+    static constexpr std::string_view kAlphabets[] = {
+      "0123456789abcdef",
+      "0123456789ABCDEF",
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567",
+      "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz",
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"};
+    static Encoding const kEncodings[] = {Encoding::Hex, Encoding::Hex, Encoding::Base32, Encoding::Base58, Encoding::Base64, Encoding::Base64};
+    _encoding = Encoding::None;
+    for (size_t k = 0; k < std::size(kAlphabets); k++) {
+      auto alphabet = kAlphabets[k];
+      if (std::equal(_charset.begin(), _charset.end(), alphabet.begin(), alphabet.end(), [](TChar lhs, char rhs) {
+            return lhs == static_cast<TChar>(rhs);
+          })) {
+        _encoding = kEncodings[k];
+        break;
+      }
+    }
+    // Tiny charsets are not only "01" or "ACGT", any symbols are fine.
+    if (_encoding == Encoding::None && _charset.size() == 2) {
+      _encoding = Encoding::Binary;
+    } else if (_encoding == Encoding::None && _charset.size() == 4) {
+      _encoding = Encoding::Quaternary;
+    } else if (_encoding == Encoding::None && _charset.size() == 8) {
+      _encoding = Encoding::Octal;
+    }
+  }
+
+  /**
+   * The table is only read with the built-in engine, so it is built by the first UseEngine() and not by constructor.
+   */
+  void BuildByteGroups()
+  {
+    if (!_byteGroups.empty() ||
+        (_encoding != Encoding::Binary && _encoding != Encoding::Quaternary && _encoding != Encoding::Hex)) {
+      return;
+    }
+    // Every byte is a group of 8, 4 or 2 symbols, so a random byte is written by one copy.
+    size_t bits = (_encoding == Encoding::Binary) ? 1 : (_encoding == Encoding::Quaternary) ? 2 : 4;
+    size_t group = 8 / bits;
+    _byteGroups.resize(256 * group);
+    for (size_t byte = 0; byte < 256; byte++) {
+      for (size_t j = 0; j < group; j++) {
+        _byteGroups[byte * group + j] = _charset[(byte >> (j * bits)) & ((1u << bits) - 1)];
+      }
+    }
+  }
+
+  void GetEncoded(TChar *out, size_t outSize)
+  {
+    switch (_encoding) {
+      case Encoding::Binary:
+        if constexpr (sizeof(TChar) == 1) {
+          GetBinaryBytes(out, outSize);
+        } else {
+          GetByteGroups<8>(out, outSize);
+        }
+        break;
+      case Encoding::Quaternary:
+        GetByteGroups<4>(out, outSize);
+        break;
+      case Encoding::Octal:
+        GetBits<3>(out, outSize);
+        break;
+      case Encoding::Hex:
+        GetByteGroups<2>(out, outSize);
+        break;
+      case Encoding::Base32:
+        GetBits<5>(out, outSize);
+        break;
+      case Encoding::Base58:
+        GetBase58(out, outSize);
+        break;
+      default:
+        GetBits<6>(out, outSize);
+        break;
+    }
+  }
+
+  /**
+   * Charsets of 2, 4 and 16 symbols, every byte of the word is expanded into a group of symbols by one copy from the
+   * table of 256 groups.
+   */
+  template<size_t group>
+  void GetByteGroups(TChar *out, size_t outSize)
+  {
+    constexpr size_t kPerWord = 8 * group;
+    constexpr size_t kBits = 8 / group;
+    auto const *groups = _byteGroups.data();
+    size_t i = 0;
+    for (; i + kPerWord <= outSize; i += kPerWord) {
+      auto word = _engine->Next();
+      for (size_t j = 0; j < 8; j++) {
+        std::memcpy(out + i + group * j, groups + group * ((word >> (8 * j)) & 0xFF), group * sizeof(TChar));
+      }
+    }
+    if (i < outSize) {
+      auto word = _engine->Next();
+      for (; i < outSize; i++, word >>= kBits) {
+        out[i] = _charset[word & ((1u << kBits) - 1)];
+      }
+    }
+  }
+
+  /**
+   * Every bit of a byte is spread into its own byte(0 or 1), so 8 symbols are first ^ bit * (first ^ second) for
+   * all bytes at once, and 64 symbols are taken from one 64 bit word.
+   */
+  static auto SpreadBits(uint64_t byte) noexcept -> uint64_t
+  {
+#if defined(__BMI2__)
+    return _pdep_u64(byte, 0x0101010101010101ull);
+#else
+    // Bit j is multiplied by 2^(7j) and lands in the lowest bit of the byte j, bit 0 is added separately to avoid carries.
+    return (((byte & 0xFE) * 0x0002040810204080ull) | (byte & 1)) & 0x0101010101010101ull;
+#endif
+  }
+
+  void GetBinaryBytes(TChar *out, size_t outSize)
+  {
+    auto first = CodeOf(_charset[0]);
+    auto zero = 0x0101010101010101ull * first;
+    auto difference = uint64_t{first ^ CodeOf(_charset[1])};
+    size_t i = 0;
+    for (; i + 64 <= outSize; i += 64) {
+      auto word = _engine->Next();
+      for (size_t j = 0; j < 8; j++) {
+        auto symbols = zero ^ (SpreadBits((word >> (8 * j)) & 0xFF) * difference);
+        std::memcpy(out + i + 8 * j, &symbols, 8);
+      }
+    }
+    if (i < outSize) {
+      auto word = _engine->Next();
+      for (; i < outSize; i++, word >>= 1) {
+        out[i] = _charset[word & 1];
+      }
+    }
+  }
+
+  /**
+   * Power of two charsets, every symbol is just the next bits of the word.
+   */
+  template<size_t bits>
+  void GetBits(TChar *out, size_t outSize)
+  {
+    constexpr size_t kPerWord = 64 / bits;
+    constexpr uint64_t kMask = (uint64_t{1} << bits) - 1;
+    auto const *charset = _charset.data();
+    size_t i = 0;
+    for (; i + kPerWord <= outSize; i += kPerWord) {
+      auto word = _engine->Next();
+      for (size_t j = 0; j < kPerWord; j++) {
+        out[i + j] = charset[(word >> (j * bits)) & kMask];
+      }
+    }
+    if (i < outSize) {
+      auto word = _engine->Next();
+      for (; i < outSize; i++, word >>= bits) {
+        out[i] = charset[word & kMask];
+      }
+    }
+  }
+
+  /**
+   * 58 is not a power of two, so a word below the biggest multiple of 58^10 is converted to 10 digits at once, and
+   * the rest(about 1.9% of words) is rejected to keep digits uniform.
+   */
+  void GetBase58(TChar *out, size_t outSize)
+  {
+    constexpr uint64_t kDigits = 10;
+    constexpr uint64_t kPower = 58ull * 58 * 58 * 58 * 58 * 58 * 58 * 58 * 58 * 58;
+    constexpr uint64_t kLimit = (std::numeric_limits<uint64_t>::max() / kPower) * kPower;
+    auto const *charset = _charset.data();
+    for (size_t i = 0; i < outSize;) {
+      uint64_t word;
+      do {
+        word = _engine->Next();
+      } while (word >= kLimit);
+      for (size_t j = 0; j < kDigits && i < outSize; j++, i++) {
+        out[i] = charset[word % 58];
+        word /= 58;
+      }
+    }
+  }
+
+  std::basic_string<TChar> _charset;
+  std::function<void()> _seed;
+  std::function<size_t(size_t)> _rand;
+  std::vector<uint32_t> _aliasThresholds;
+  std::vector<uint32_t> _aliases;
+  static constexpr size_t kMaxArithmeticRanges = 4;
+  static constexpr size_t kMinArithmeticTableBytes = 16 * 1024;
+  size_t _symbolCount;
+  size_t _rangeCount{};
+  uint32_t _rangeBegins[kMaxArithmeticRanges]{};
+  uint32_t _rangeSteps[kMaxArithmeticRanges]{};
+  // Only for charsets which are described by more than kMaxArithmeticRanges ranges.
+  std::vector<uint32_t> _rangeFirsts;
+  std::vector<uint32_t> _rangePrefix;
+  static constexpr size_t kAsyncChunk = 1 << 22;
+  static constexpr size_t kAsyncStep = 1 << 16;
+  static constexpr char kStateMagic[4] = {'R', 'S', 'G', 'S'};
+  static constexpr unsigned char kStateVersion = 1;
+  static constexpr unsigned char kLastShortFlag = 1;
+  std::optional<Xoshiro256> _engine;
+  static constexpr size_t kStreamingThreshold = 16 << 20;
+  static constexpr size_t kStagingBytes = 4096;
+  StreamingStores _streaming{StreamingStores::Auto};
+  size_t _streamingThreshold{kStreamingThreshold};
+  static constexpr size_t kPoolSize = 4096;
+  static constexpr size_t kPoolMaxRequest = 64;
+  std::vector<TChar> _pool;
+  size_t _poolNext{};
+  std::optional<Xoshiro256> _poolEngine;
+  bool _lastShort{};
+  size_t _refills{};
+  Encoding _encoding{Encoding::None};
+  std::vector<TChar> _byteGroups;
+};
+
+using RandomStringGenerator = RandomStringGeneratorBase<char>;
+using RandomStringGeneratorW = RandomStringGeneratorBase<wchar_t>;
+// Only for symbols from BMP, use Utf16StringGenerator for charsets with surrogate pairs.
+using RandomStringGenerator16 = RandomStringGeneratorBase<char16_t>;
+using RandomStringGenerator32 = RandomStringGeneratorBase<char32_t>;
+
+/**
+ * Lazy view of length random symbols, they are generated by blocks of about kBlockBytes while the view is iterated,
+ * so the output goes to any sink(std::copy, hashing, insertion) without intermediate string of the whole length.
+ * @note It is an input range like std::istream_iterator: one pass, the view should outlive its iterators and should
+ * not be moved while it is iterated. begin() and end() have the same type, so it works with C++20 ranges too.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class GeneratedCharactersBase
+{
+public:
+  static constexpr size_t kBlockBytes = 16 * 1024;
+  static constexpr size_t kBlockSize = kBlockBytes / sizeof(TChar);
+
+  class Iterator;
+
+  /**
+   * @param generator should outlive the view
+   * @param length amount of symbols
+   */
+  GeneratedCharactersBase(RandomStringGeneratorBase<TChar> &generator, size_t length)
+      : _generator{&generator}, _length{length}
+  {
+  }
+
+  auto size() const noexcept -> size_t
+  {
+    return _length;
+  }
+
+  auto begin() -> Iterator
+  {
+    Fill(0);
+    return Iterator(this, 0);
+  }
+
+  auto end() noexcept -> Iterator
+  {
+    return Iterator(this, _length);
+  }
+
+  /**
+   * Input iterator, the block is refilled when the iterator goes to the next one.
+   */
+  class Iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = TChar;
+    using difference_type = std::ptrdiff_t;
+    using pointer = TChar const *;
+    using reference = TChar const &;
+
+    Iterator() = default;
+
+    Iterator(GeneratedCharactersBase *view, size_t index) noexcept
+        : _view{view}, _index{index}
+    {
+    }
+
+    auto operator*() const noexcept -> TChar const &
+    {
+      return _view->_block[_index % kBlockSize];
+    }
+
+    auto operator++() -> Iterator &
+    {
+      if (++_index % kBlockSize == 0) {
+        _view->Fill(_index);
+      }
+      return *this;
+    }
+
+    /**
+     * The block can be refilled by the increment, so the previous symbol is kept by the proxy.
+     */
+    class Proxy
+    {
+    public:
+      explicit Proxy(TChar value) noexcept
+          : _value{value}
+      {
+      }
+
+      auto operator*() const noexcept -> TChar
+      {
+        return _value;
+      }
+
+    private:
+      TChar _value;
+    };
+
+    auto operator++(int) -> Proxy
+    {
+      Proxy previous(**this);
+      ++*this;
+      return previous;
+    }
+
+    auto operator==(Iterator const &other) const noexcept -> bool
+    {
+      return _index == other._index;
+    }
+
+    auto operator!=(Iterator const &other) const noexcept -> bool
+    {
+      return _index != other._index;
+    }
+
+  private:
+    GeneratedCharactersBase *_view{};
+    size_t _index{};
+  };
+
+private:
+  void Fill(size_t index)
+  {
+    if (index < _length) {
+      _block.resize(kBlockSize);
+      _generator->get(_block.data(), std::min(kBlockSize, _length - index));
+    }
+  }
+
+  RandomStringGeneratorBase<TChar> *_generator;
+  size_t _length;
+  std::vector<TChar> _block;
+};
+
+using GeneratedCharacters = GeneratedCharactersBase<char>;
+using GeneratedCharactersW = GeneratedCharactersBase<wchar_t>;
+
+/**
+ * Lazy view of count random strings of the same length, a lot of strings are generated by one call of the generator
+ * into the block of about kBlockBytes, every element is a string view into the block, so there is not any allocation
+ * per string.
+ * @note It is an input range, a string view is valid until the iterator goes to the next block.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class GeneratedStringsBase
+{
+public:
+  static constexpr size_t kBlockBytes = 16 * 1024;
+
+  class Iterator;
+
+  /**
+   * @param generator should outlive the view
+   * @param count amount of strings
+   * @param length of every string
+   */
+  GeneratedStringsBase(RandomStringGeneratorBase<TChar> &generator, size_t count, size_t length)
+      : _generator{&generator}, _count{count}, _length{length},
+        _blockStrings{std::max<size_t>(kBlockBytes / sizeof(TChar) / std::max<size_t>(length, 1), 1)}
+  {
+  }
+
+  auto size() const noexcept -> size_t
+  {
+    return _count;
+  }
+
+  auto begin() -> Iterator
+  {
+    Fill(0);
+    return Iterator(this, 0);
+  }
+
+  auto end() noexcept -> Iterator
+  {
+    return Iterator(this, _count);
+  }
+
+  /**
+   * Input iterator, every dereference gives a view of the string in the current block.
+   */
+  class Iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::basic_string_view<TChar>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::basic_string_view<TChar>;
+
+    Iterator() = default;
+
+    Iterator(GeneratedStringsBase *view, size_t index) noexcept
+        : _view{view}, _index{index}
+    {
+    }
+
+    auto operator*() const noexcept -> std::basic_string_view<TChar>
+    {
+      return {_view->_block.data() + _index % _view->_blockStrings * _view->_length, _view->_length};
+    }
+
+    auto operator++() -> Iterator &
+    {
+      if (++_index % _view->_blockStrings == 0) {
+        _view->Fill(_index);
+      }
+      return *this;
+    }
+
+    /**
+     * The block can be refilled by the increment, so the previous string is copied into the proxy.
+     */
+    class Proxy
+    {
+    public:
+      explicit Proxy(std::basic_string_view<TChar> value)
+          : _value{value}
+      {
+      }
+
+      auto operator*() const -> std::basic_string<TChar>
+      {
+        return _value;
+      }
+
+    private:
+      std::basic_string<TChar> _value;
+    };
+
+    auto operator++(int) -> Proxy
+    {
+      Proxy previous(**this);
+      ++*this;
+      return previous;
+    }
+
+    auto operator==(Iterator const &other) const noexcept -> bool
+    {
+      return _index == other._index;
+    }
+
+    auto operator!=(Iterator const &other) const noexcept -> bool
+    {
+      return _index != other._index;
+    }
+
+  private:
+    GeneratedStringsBase *_view{};
+    size_t _index{};
+  };
+
+private:
+  void Fill(size_t index)
+  {
+    if (index < _count) {
+      _block.resize(_blockStrings * _length);
+      _generator->get(_block.data(), std::min(_blockStrings, _count - index) * _length);
+    }
+  }
+
+  RandomStringGeneratorBase<TChar> *_generator;
+  size_t _count;
+  size_t _length;
+  size_t _blockStrings;
+  std::vector<TChar> _block;
+};
+
+using GeneratedStrings = GeneratedStringsBase<char>;
+using GeneratedStringsW = GeneratedStringsBase<wchar_t>;
+
+/**
+ * @param generator should outlive the view
+ * @param length amount of symbols
+ * @return lazy view of random symbols
+ */
+template<typename TChar>
+auto GenerateView(RandomStringGeneratorBase<TChar> &generator, size_t length) -> GeneratedCharactersBase<TChar>
+{
+  return GeneratedCharactersBase<TChar>(generator, length);
+}
+
+/**
+ * @param generator should outlive the view
+ * @param count amount of strings
+ * @param length of every string
+ * @return lazy view of random strings
+ */
+template<typename TChar>
+auto StringsView(RandomStringGeneratorBase<TChar> &generator, size_t count, size_t length) -> GeneratedStringsBase<TChar>
+{
+  return GeneratedStringsBase<TChar>(generator, count, length);
+}
+
+/**
+ * Generator for latency sensitive callers: a background thread keeps a ring of ready symbols, so get() is just a copy.
+ * The ring is single producer single consumer without locks, the producer takes batches as big as the consumption
+ * since the previous batch, so fast consumers get big batches and slow ones do not keep the thread busy.
+ * @note If the ring is empty, the rest of the request is generated on the spot by the second engine which is one jump
+ * after the engine of the background thread, so get() never waits. get() should be called by one thread at a time.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class PrefilledStringGeneratorBase
+{
+public:
+  static constexpr size_t kMinBatch = 256;
+
+  /**
+   * @param generator with the built-in engine, it is copied and continues two jumps later, after the engines of the
+   * background thread and of the fallback, so it does not repeat their symbols
+   * @param capacity of the ring, it is rounded up to a power of two
+   */
+  explicit PrefilledStringGeneratorBase(RandomStringGeneratorBase<TChar> &generator, size_t capacity = 1 << 16)
+      : _producer{generator}, _fallback{generator}
+  {
+    if (!generator.HasEngine()) {
+      throw std::logic_error("prefill needs the built-in engine, call UseEngine() first");
+    }
+    _capacity = kMinBatch * 2;
+    while (_capacity < capacity) {
+      _capacity *= 2;
+    }
+    _ring.reset(new TChar[_capacity]);
+    // Copies start without the pool of the generator, otherwise they would give the same symbols.
+    auto engine = generator.Engine();
+    _producer.UseEngine(engine);
+    engine.Jump();
+    _fallback.UseEngine(engine);
+    engine.Jump();
+    generator.UseEngine(engine);
+    _thread = std::thread([this]() { Produce(); });
+  }
+
+  PrefilledStringGeneratorBase(PrefilledStringGeneratorBase const &) = delete;
+  PrefilledStringGeneratorBase &operator=(PrefilledStringGeneratorBase const &) = delete;
+
+  ~PrefilledStringGeneratorBase()
+  {
+    _stopping = true;
+    _thread.join();
+  }
+
+  template<typename T>
+  auto get(size_t outSize) -> T
+  {
+    T result(outSize, TChar{});
+    get(result.data(), outSize);
+    return result;
+  }
+
+  void get(TChar *out, size_t outSize)
+  {
+    auto head = _head.load(std::memory_order_relaxed);
+    auto ready = std::min(outSize, _tail.load(std::memory_order_acquire) - head);
+    auto first = std::min(ready, _capacity - (head & (_capacity - 1)));
+    std::copy(_ring.get() + (head & (_capacity - 1)), _ring.get() + (head & (_capacity - 1)) + first, out);
+    std::copy(_ring.get(), _ring.get() + (ready - first), out + first);
+    _head.store(head + ready, std::memory_order_release);
+    if (ready < outSize) {
+      _fallback.get(out + ready, outSize - ready);
+      _misses++;
+    }
+  }
+
+  /**
+   * @return amount of requests which were not fully served from the ring
+   */
+  auto Misses() const noexcept -> size_t
+  {
+    return _misses;
+  }
+
+private:
+  void Produce()
+  {
+    size_t lastHead = 0;
+    auto batch = kMinBatch;
+    while (!_stopping.load(std::memory_order_relaxed)) {
+      auto head = _head.load(std::memory_order_acquire);
+      auto tail = _tail.load(std::memory_order_relaxed);
+      // Batch follows the consumption since the previous look at the ring.
+      batch = std::min(std::max(head - lastHead, kMinBatch), _capacity / 2);
+      lastHead = head;
+      if (_capacity - (tail - head) < batch) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        continue;
+      }
+      auto first = std::min(batch, _capacity - (tail & (_capacity - 1)));
+      _producer.get(_ring.get() + (tail & (_capacity - 1)), first);
+      if (first < batch) {
+        _producer.get(_ring.get(), batch - first);
+      }
+      _tail.store(tail + batch, std::memory_order_release);
+    }
+  }
+
+  RandomStringGeneratorBase<TChar> _producer;
+  RandomStringGeneratorBase<TChar> _fallback;
+  size_t _capacity{};
+  std::unique_ptr<TChar[]> _ring;
+  // Positions only grow, the index in the ring is position & (capacity - 1).
+  alignas(64) std::atomic<size_t> _head{};
+  alignas(64) std::atomic<size_t> _tail{};
+  alignas(64) std::atomic<bool> _stopping{};
+  size_t _misses{};
+  std::thread _thread;
+};
+
+using PrefilledStringGenerator = PrefilledStringGeneratorBase<char>;
+using PrefilledStringGeneratorW = PrefilledStringGeneratorBase<wchar_t>;
+// ... etc
+
+/**
+ * Collision free generator, every index from [0, Size()) is mapped to its own string by a keyed bijection, so there is
+ * nothing to deduplicate and nothing to remember. Parallel generation is just splitting the range of indices.
+ * @note The bijection is a Feistel network over the smallest even bit width which covers |charset|^length, results
+ * which are out of the range are passed through the network again(cycle walking), so it is still a bijection on exactly
+ * |charset|^length values. Index is the rank of the string, so Index(get(i)) == i.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class PermutationStringGeneratorBase
+{
+public:
+  /**
+   * @param charset all symbols should be unique otherwise it could not be a bijection.
+   * @param length of every generated string.
+   * @param key the same key gives the same permutation.
+   */
+  PermutationStringGeneratorBase(std::basic_string<TChar> charset, size_t length, uint64_t key)
+      : _charset{std::move(charset)}, _length{length}
+  {
+    if (_charset.empty()) {
+      throw std::invalid_argument("charset should not be empty");
+    }
+    _size = 1;
+    for (size_t i = 0; i < _length; i++) {
+      if (_size > std::numeric_limits<uint64_t>::max() / _charset.size()) {
+        throw std::overflow_error("charset size to the power of length does not fit in 64 bits");
+      }
+      _size *= _charset.size();
+    }
+    size_t bits = 0;
+    while (bits < 64 && (uint64_t{1} << bits) < _size) {
+      bits++;
+    }
+    _halfBits = std::max<size_t>((bits + 1) / 2, 1);
+    _halfMask = (_halfBits == 32) ? 0xFFFFFFFFull : ((uint64_t{1} << _halfBits) - 1);
+    for (size_t round = 0; round < kRounds; round++) {
+      _roundKeys[round] = SplitMix64(key + round * 0x9E3779B97F4A7C15ull);
+    }
+
+    _ranks.reserve(_charset.size());
+    for (size_t i = 0; i < _charset.size(); i++) {
+      _ranks.emplace_back(_charset[i], i);
+    }
+    std::sort(_ranks.begin(), _ranks.end());
+    if (std::adjacent_find(_ranks.begin(), _ranks.end(), [](auto const &lhs, auto const &rhs) {
+          return lhs.first == rhs.first;
+        }) != _ranks.end()) {
+      throw std::invalid_argument("charset should not contain duplicated symbols");
+    }
+  }
+
+  /**
+   * Amount of different strings, any index below it is valid.
+   * @return
+   */
+  auto Size() const noexcept -> uint64_t
+  {
+    return _size;
+  }
+
+  /**
+   * Helper for returning result in some container like vector or string.
+   * @tparam T
+   * @param index
+   * @return
+   */
+  template<typename T>
+  auto get(uint64_t index) const -> T
+  {
+    T result(_length, {});
+    get(index, result.data());
+    return result;
+  }
+
+  /**
+   * Writes the string which corresponds to index.
+   * @param index should be less than Size()
+   * @param out should have space for length symbols
+   */
+  void get(uint64_t index, TChar *out) const
+  {
+    auto value = index;
+    do {
+      value = Encrypt(value);
+    } while (value >= _size);
+    for (size_t i = _length; i > 0; i--) {
+      out[i - 1] = _charset[value % _charset.size()];
+      value /= _charset.size();
+    }
+  }
+
+  /**
+   * Back mapping from a string to its index.
+   * @param in should have length symbols which are from the charset
+   * @return
+   */
+  auto Index(TChar const *in) const -> uint64_t
+  {
+    uint64_t value = 0;
+    for (size_t i = 0; i < _length; i++) {
+      auto found = std::lower_bound(_ranks.begin(), _ranks.end(), std::make_pair(in[i], size_t{0}));
+      if (found == _ranks.end() || found->first != in[i]) {
+        throw std::invalid_argument("symbol is not from the charset");
+      }
+      value = value * _charset.size() + found->second;
+    }
+    do {
+      value = Decrypt(value);
+    } while (value >= _size);
+    return value;
+  }
+
+private:
+  static constexpr size_t kRounds = 8;
+
+  auto Round(size_t round, uint64_t half) const noexcept -> uint64_t
+  {
+    return SplitMix64(half ^ _roundKeys[round]) & _halfMask;
+  }
+
+  auto Encrypt(uint64_t value) const noexcept -> uint64_t
+  {
+    auto left = value >> _halfBits;
+    auto right = value & _halfMask;
+    for (size_t round = 0; round < kRounds; round++) {
+      auto next = left ^ Round(round, right);
+      left = right;
+      right = next;
+    }
+    return (left << _halfBits) | right;
+  }
+
+  auto Decrypt(uint64_t value) const noexcept -> uint64_t
+  {
+    auto left = value >> _halfBits;
+    auto right = value & _halfMask;
+    for (size_t round = kRounds; round > 0; round--) {
+      auto previous = right ^ Round(round - 1, left);
+      right = left;
+      left = previous;
+    }
+    return (left << _halfBits) | right;
+  }
+
+  std::basic_string<TChar> _charset;
+  std::vector<std::pair<TChar, size_t>> _ranks;
+  size_t _length;
+  uint64_t _size;
+  size_t _halfBits;
+  uint64_t _halfMask;
+  uint64_t _roundKeys[kRounds];
+};
+
+using PermutationStringGenerator = PermutationStringGeneratorBase<char>;
+using PermutationStringGeneratorW = PermutationStringGeneratorBase<wchar_t>;
+
+/**
+ * Virtual container of count random strings, string i is always the same for the same seed, but it is produced only
+ * when it is accessed, so even a "billion rows table" takes only the memory of a small cache.
+ * @note Strings are made by chunks of kChunkStrings, every chunk is one bulk call of the generator with the built-in
+ * engine seeded from (seed, chunk). Iteration goes chunk by chunk, random access keeps the last chunks in a direct
+ * mapped cache.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class RandomStringSequenceBase
+{
+public:
+  static constexpr size_t kChunkStrings = 64;
+
+  class Iterator;
+
+  /**
+   * @param charset
+   * @param count amount of strings
+   * @param length of every string
+   * @param seed
+   * @param cacheChunks amount of chunks which are kept in the cache
+   */
+  RandomStringSequenceBase(std::basic_string<TChar> charset, size_t count, size_t length, uint64_t seed, size_t cacheChunks = 16)
+      : _generator{std::move(charset)}, _count{count}, _length{length}, _seed{seed}, _cache(std::max<size_t>(cacheChunks, 1))
+  {
+  }
+
+  auto size() const noexcept -> size_t
+  {
+    return _count;
+  }
+
+  /**
+   * @param index should be less than size()
+   * @return view which is valid until the chunk is pushed out from the cache, at least until the next access
+   */
+  auto operator[](size_t index) -> std::basic_string_view<TChar>
+  {
+    auto chunkIndex = index / kChunkStrings;
+    auto &chunk = _cache[chunkIndex % _cache.size()];
+    if (chunk.index != chunkIndex || chunk.symbols.empty()) {
+      _misses++;
+      chunk.index = chunkIndex;
+      chunk.symbols.resize(kChunkStrings * _length);
+      _generator.UseEngine(Xoshiro256(SplitMix64(_seed ^ SplitMix64(chunkIndex))));
+      _generator.get(chunk.symbols.data(), chunk.symbols.size());
+    }
+    return std::basic_string_view<TChar>(chunk.symbols.data() + (index % kChunkStrings) * _length, _length);
+  }
+
+  /**
+   * Helper for returning a copy in some container like vector or string.
+   * @tparam T
+   * @param index
+   * @return
+   */
+  template<typename T>
+  auto get(size_t index) -> T
+  {
+    auto view = (*this)[index];
+    return T(view.begin(), view.end());
+  }
+
+  /**
+   * How many chunks were generated, for tuning of the cache.
+   * @return
+   */
+  auto CacheMisses() const noexcept -> size_t
+  {
+    return _misses;
+  }
+
+  auto begin() noexcept -> Iterator
+  {
+    return Iterator(this, 0);
+  }
+
+  auto end() noexcept -> Iterator
+  {
+    return Iterator(this, _count);
+  }
+
+  /**
+   * Input iterator, every dereference gives a view of the next string which is valid until the next increment.
+   */
+  class Iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::basic_string_view<TChar>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::basic_string_view<TChar>;
+
+    Iterator() = default;
+
+    Iterator(RandomStringSequenceBase *sequence, size_t index) noexcept
+        : _sequence{sequence}, _index{index}
+    {
+    }
+
+    auto operator*() const -> std::basic_string_view<TChar>
+    {
+      return (*_sequence)[_index];
+    }
+
+    auto operator++() noexcept -> Iterator &
+    {
+      _index++;
+      return *this;
+    }
+
+    auto operator++(int) noexcept -> Iterator
+    {
+      auto previous = *this;
+      _index++;
+      return previous;
+    }
+
+    auto operator==(Iterator const &other) const noexcept -> bool
+    {
+      return _index == other._index;
+    }
+
+    auto operator!=(Iterator const &other) const noexcept -> bool
+    {
+      return _index != other._index;
+    }
+
+  private:
+    RandomStringSequenceBase *_sequence{};
+    size_t _index{};
+  };
+
+private:
+  struct Chunk
+  {
+    size_t index{};
+    std::basic_string<TChar> symbols;
+  };
+
+  RandomStringGeneratorBase<TChar> _generator;
+  size_t _count;
+  size_t _length;
+  uint64_t _seed;
+  std::vector<Chunk> _cache;
+  size_t _misses{};
+};
+
+using RandomStringSequence = RandomStringSequenceBase<char>;
+using RandomStringSequenceW = RandomStringSequenceBase<wchar_t>;
+
+/**
+ * Deterministic derivation string = f(secret, key), for pseudonymization: the same key is always the same random
+ * looking string, and without the secret it can not be linked back to the key. The keyed function is SipHash-2-4.
+ * @note Keys are processed by lanes of kLanes, states of all lanes are arrays, so every SipHash round is a loop over
+ * lanes which is vectorized by the compiler. Every 64 bits of SipHash output give several symbols by multiply and
+ * shift, at least 32 bits are left unused, so the bias of a symbol is below |charset| / 2^32.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class KeyedStringDeriverBase
+{
+public:
+  static constexpr size_t kLanes = 8;
+
+  /**
+   * @param charset
+   * @param length of every derived string
+   * @param secret0 first half of 128 bits secret
+   * @param secret1 second half of 128 bits secret
+   */
+  KeyedStringDeriverBase(std::basic_string<TChar> charset, size_t length, uint64_t secret0, uint64_t secret1)
+      : _charset{std::move(charset)}, _length{length}, _secret{secret0, secret1}
+  {
+    if (_charset.empty() || _charset.size() > std::numeric_limits<uint32_t>::max()) {
+      throw std::invalid_argument("charset should have from 1 to 2^32 - 1 symbols");
+    }
+    size_t bits = 1;
+    while ((uint64_t{1} << bits) < _charset.size()) {
+      bits++;
+    }
+    _perWord = std::max<size_t>(32 / bits, 1);
+  }
+
+  /**
+   * Helper for returning result in some container like vector or string.
+   * @tparam T
+   * @param key
+   * @return
+   */
+  template<typename T>
+  auto get(uint64_t key) const -> T
+  {
+    T result(_length, {});
+    Derive(&key, 1, result.data());
+    return result;
+  }
+
+  /**
+   * Batch of numeric keys like user ids.
+   * @param keys
+   * @param count
+   * @param out should have space for count * length symbols, string of keys[i] starts at out + i * length
+   */
+  void Derive(uint64_t const *keys, size_t count, TChar *out) const
+  {
+    for (size_t first = 0; first < count; first += kLanes) {
+      auto lanes = std::min(kLanes, count - first);
+      uint64_t laneKeys[kLanes] = {};
+      std::copy(keys + first, keys + first + lanes, laneKeys);
+      DeriveLanes(laneKeys, lanes, out + first * _length);
+    }
+  }
+
+  /**
+   * Batch of byte string keys like emails, every key is first hashed to 64 bits with a separate secret.
+   * @param keys
+   * @param count
+   * @param out should have space for count * length symbols
+   */
+  void Derive(std::string_view const *keys, size_t count, TChar *out) const
+  {
+    for (size_t first = 0; first < count; first += kLanes) {
+      auto lanes = std::min(kLanes, count - first);
+      uint64_t laneKeys[kLanes] = {};
+      for (size_t lane = 0; lane < lanes; lane++) {
+        laneKeys[lane] = SipHash(_secret[0] ^ kBytesDomain, _secret[1], keys[first + lane]);
+      }
+      DeriveLanes(laneKeys, lanes, out + first * _length);
+    }
+  }
+
+private:
+  static constexpr uint64_t kBytesDomain = 0x62797465734B6579ull;
+
+  static auto Rotate(uint64_t x, int k) noexcept -> uint64_t
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  static void Round(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) noexcept
+  {
+    v0 += v1;
+    v1 = Rotate(v1, 13);
+    v1 ^= v0;
+    v0 = Rotate(v0, 32);
+    v2 += v3;
+    v3 = Rotate(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = Rotate(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = Rotate(v1, 17);
+    v1 ^= v2;
+    v2 = Rotate(v2, 32);
+  }
+
+  /**
+   * Usual SipHash-2-4 of a byte string.
+   */
+  static auto SipHash(uint64_t k0, uint64_t k1, std::string_view message) noexcept -> uint64_t
+  {
+    uint64_t v0 = k0 ^ 0x736F6D6570736575ull;
+    uint64_t v1 = k1 ^ 0x646F72616E646F6Dull;
+    uint64_t v2 = k0 ^ 0x6C7967656E657261ull;
+    uint64_t v3 = k1 ^ 0x7465646279746573ull;
+    auto const *bytes = reinterpret_cast<unsigned char const *>(message.data());
+    auto blocks = message.size() / 8;
+    for (size_t i = 0; i < blocks; i++) {
+      uint64_t m = 0;
+      for (size_t j = 0; j < 8; j++) {
+        m |= uint64_t{bytes[8 * i + j]} << (8 * j);
+      }
+      v3 ^= m;
+      Round(v0, v1, v2, v3);
+      Round(v0, v1, v2, v3);
+      v0 ^= m;
+    }
+    uint64_t last = uint64_t{message.size() & 0xFF} << 56;
+    for (size_t j = 0; j < message.size() % 8; j++) {
+      last |= uint64_t{bytes[8 * blocks + j]} << (8 * j);
+    }
+    v3 ^= last;
+    Round(v0, v1, v2, v3);
+    Round(v0, v1, v2, v3);
+    v0 ^= last;
+    v2 ^= 0xFF;
+    for (size_t i = 0; i < 4; i++) {
+      Round(v0, v1, v2, v3);
+    }
+    return v0 ^ v1 ^ v2 ^ v3;
+  }
+
+  /**
+   * SipHash-2-4 of the 16 bytes message (key, counter) for all lanes at once.
+   */
+  void SipHashLanes(uint64_t const *keys, uint64_t counter, uint64_t *out) const noexcept
+  {
+    uint64_t v0[kLanes], v1[kLanes], v2[kLanes], v3[kLanes];
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      v0[lane] = _secret[0] ^ 0x736F6D6570736575ull;
+      v1[lane] = _secret[1] ^ 0x646F72616E646F6Dull;
+      v2[lane] = _secret[0] ^ 0x6C7967656E657261ull;
+      v3[lane] = _secret[1] ^ 0x7465646279746573ull ^ keys[lane];
+    }
+    auto rounds = [&](size_t count) {
+      for (size_t i = 0; i < count; i++) {
+        for (size_t lane = 0; lane < kLanes; lane++) {
+          Round(v0[lane], v1[lane], v2[lane], v3[lane]);
+        }
+      }
+    };
+    rounds(2);
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      v0[lane] ^= keys[lane];
+      v3[lane] ^= counter;
+    }
+    rounds(2);
+    uint64_t const last = uint64_t{16} << 56;
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      v0[lane] ^= counter;
+      v3[lane] ^= last;
+    }
+    rounds(2);
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      v0[lane] ^= last;
+      v2[lane] ^= 0xFF;
+    }
+    rounds(4);
+    for (size_t lane = 0; lane < kLanes; lane++) {
+      out[lane] = v0[lane] ^ v1[lane] ^ v2[lane] ^ v3[lane];
+    }
+  }
+
+  void DeriveLanes(uint64_t const *keys, size_t lanes, TChar *out) const
+  {
+    auto const *charset = _charset.data();
+    auto size = static_cast<uint64_t>(_charset.size());
+    uint64_t words[kLanes];
+    for (size_t done = 0, counter = 0; done < _length; done += _perWord, counter++) {
+      SipHashLanes(keys, counter, words);
+      auto count = std::min(_perWord, _length - done);
+      for (size_t lane = 0; lane < lanes; lane++) {
+        auto word = words[lane];
+        for (size_t j = 0; j < count; j++) {
+          // The highest bits of word * size are the symbol, the lowest are what is left for the next symbols.
+          auto high = MultiplyHigh(word, size);
+          word *= size;
+          out[lane * _length + done + j] = charset[high];
+        }
+      }
+    }
+  }
+
+  static auto MultiplyHigh(uint64_t lhs, uint64_t rhs) noexcept -> uint64_t
+  {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(lhs) * rhs) >> 64);
+#else
+    // rhs is below 2^32, so two halves are enough.
+    auto low = (lhs & 0xFFFFFFFFull) * rhs;
+    auto high = (lhs >> 32) * rhs;
+    return (high + (low >> 32)) >> 32;
+#endif
+  }
+
+  std::basic_string<TChar> _charset;
+  size_t _length;
+  uint64_t _secret[2];
+  size_t _perWord;
+};
+
+using KeyedStringDeriver = KeyedStringDeriverBase<char>;
+using KeyedStringDeriverW = KeyedStringDeriverBase<wchar_t>;
+
+/**
+ * Uniformly random strings which come already in lexicographic order, without generation of all of them and sorting.
+ * Sorted uniform numbers are generated one by one by the spacings(the next one is the previous one plus an exponential
+ * step), every number is unranked into the first symbols of the string, the rest of symbols is random and the strings
+ * with the same first symbols are sorted among themselves.
+ * @note Memory is one group of strings with the same first symbols, about count / |charset|^prefixLength strings
+ * where the first symbols are as many as give at most 2^48 keys. It is only a few strings unless count is near the key
+ * space, e.g. for very short strings, then groups grow with count. The key space can be split by shards: every shard
+ * takes its part of the first symbols and its amount of strings is a binomial draw which is the same in all shards for
+ * the same seed and the same math functions(std::log, std::cos, std::sqrt give the same results), so concatenation of
+ * shards 0..shardCount - 1 is one sorted sample of count strings.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class SortedStringGeneratorBase
+{
+public:
+  /**
+   * @param charset symbols are sorted, repeated symbols are not allowed
+   * @param count amount of strings in all shards
+   * @param length of every string
+   * @param seed should be the same in all shards
+   * @param shard index of this shard
+   * @param shardCount
+   */
+  SortedStringGeneratorBase(std::basic_string<TChar> charset, size_t count, size_t length, uint64_t seed, size_t shard = 0,
+                            size_t shardCount = 1)
+      : _charset{std::move(charset)}, _length{length}, _engine{SplitMix64(seed ^ SplitMix64(shard + 1))}
+  {
+    std::sort(_charset.begin(), _charset.end(), std::char_traits<TChar>::lt);
+    if (_charset.empty() || std::adjacent_find(_charset.begin(), _charset.end()) != _charset.end()) {
+      throw std::invalid_argument("charset should have unique symbols");
+    }
+    if (length == 0) {
+      throw std::invalid_argument("length should be positive");
+    }
+    // First symbols are given by the sorted numbers, as many as fit in the precision of double.
+    _prefixSpace = 1;
+    while (_prefixLength < _length && _prefixSpace <= kMaxPrefixSpace / _charset.size()) {
+      _prefixSpace *= _charset.size();
+      _prefixLength++;
+    }
+    if (shardCount == 0 || shard >= shardCount || shardCount > _prefixSpace) {
+      throw std::invalid_argument("shard should be less than shardCount, shardCount should not exceed the key space");
+    }
+    auto shardWidth = [&](size_t index) {
+      return _prefixSpace / shardCount + (index < _prefixSpace % shardCount ? 1 : 0);
+    };
+    // Amounts of strings in shards before this one, every shard repeats the same draws.
+    Xoshiro256 counts(seed);
+    auto remaining = count;
+    auto remainingSpace = _prefixSpace;
+    for (size_t index = 0; index < shard; index++) {
+      auto width = shardWidth(index);
+      remaining -= Binomial(counts, remaining, static_cast<double>(width) / remainingSpace);
+      remainingSpace -= width;
+      _prefixBegin += width;
+    }
+    _prefixWidth = shardWidth(shard);
+    _count = shard + 1 == shardCount
+                 ? remaining
+                 : Binomial(counts, remaining, static_cast<double>(_prefixWidth) / remainingSpace);
+    _left = _count;
+    Advance();
+  }
+
+  /**
+   * Amount of strings in this shard.
+   */
+  auto Size() const noexcept -> size_t
+  {
+    return _count;
+  }
+
+  auto Done() const noexcept -> bool
+  {
+    return _groupNext == _group.size() && !_havePrefix;
+  }
+
+  /**
+   * The next string, it is not less than the previous one.
+   * @param out should have space for length symbols
+   */
+  void get(TChar *out)
+  {
+    if (_groupNext == _group.size()) {
+      NextGroup();
+    }
+    auto &tail = _group[_groupNext++];
+    auto prefix = _groupPrefix;
+    for (auto i = _prefixLength; i > 0; i--) {
+      out[i - 1] = _charset[prefix % _charset.size()];
+      prefix /= _charset.size();
+    }
+    std::copy(tail.begin(), tail.end(), out + _prefixLength);
+  }
+
+  template<typename T>
+  auto get() -> T
+  {
+    T result(_length, TChar{});
+    get(result.data());
+    return result;
+  }
+
+private:
+  static constexpr uint64_t kMaxPrefixSpace = uint64_t{1} << 48;
+
+  /**
+   * Uniform from (0, 1].
+   */
+  static auto Uniform(Xoshiro256 &engine) noexcept -> double
+  {
+    return static_cast<double>((engine.Next() >> 11) + 1) * 0x1p-53;
+  }
+
+  /**
+   * Gamma(shape) for shape >= 1 by Marsaglia and Tsang, normal numbers by Box-Muller.
+   */
+  static auto Gamma(Xoshiro256 &engine, double shape) noexcept -> double
+  {
+    auto d = shape - 1.0 / 3;
+    auto c = 1 / std::sqrt(9 * d);
+    for (;;) {
+      double x;
+      double v;
+      do {
+        x = std::sqrt(-2 * std::log(Uniform(engine))) * std::cos(6.283185307179586 * Uniform(engine));
+        v = 1 + c * x;
+      } while (v <= 0);
+      v = v * v * v;
+      auto u = Uniform(engine);
+      if (u < 1 - 0.0331 * x * x * x * x || std::log(u) < 0.5 * x * x + d * (1 - v + std::log(v))) {
+        return d * v;
+      }
+    }
+  }
+
+  /**
+   * Binomial(trials, probability) on the built-in engine instead of std::binomial_distribution whose algorithm is not
+   * specified, so all shards get the same amounts when they are built with the same math library. Big amounts of trials are halved by the order statistic of uniforms(it is a beta variate), the rest is
+   * counted directly.
+   */
+  static auto Binomial(Xoshiro256 &engine, size_t trials, double probability) noexcept -> size_t
+  {
+    size_t result = 0;
+    while (trials > 64 && probability > 0 && probability < 1) {
+      auto a = 1 + trials / 2;
+      auto b = trials + 1 - a;
+      auto gammaA = Gamma(engine, static_cast<double>(a));
+      auto x = gammaA / (gammaA + Gamma(engine, static_cast<double>(b)));
+      if (x >= probability) {
+        trials = a - 1;
+        probability /= x;
+      } else {
+        result += a;
+        trials = b - 1;
+        probability = (probability - x) / (1 - x);
+      }
+    }
+    if (probability >= 1) {
+      return result + trials;
+    }
+    for (size_t i = 0; i < trials && probability > 0; i++) {
+      result += Uniform(engine) <= probability ? 1 : 0;
+    }
+    return result;
+  }
+
+  /**
+   * The next sorted number, it is kept as log(1 - x), so the precision is not lost near both ends.
+   */
+  void Advance()
+  {
+    _havePrefix = _left > 0;
+    if (!_havePrefix) {
+      return;
+    }
+    _logRest += std::log(Uniform(_engine)) / static_cast<double>(_left);
+    _left--;
+    auto position = static_cast<uint64_t>(-std::expm1(_logRest) * static_cast<double>(_prefixWidth));
+    _nextPrefix = _prefixBegin + std::min(position, _prefixWidth - 1);
+  }
+
+  void NextGroup()
+  {
+    if (!_havePrefix) {
+      throw std::logic_error("all strings of the shard were already taken");
+    }
+    _groupPrefix = _nextPrefix;
+    _group.clear();
+    _groupNext = 0;
+    while (_havePrefix && _nextPrefix == _groupPrefix) {
+      std::basic_string<TChar> tail(_length - _prefixLength, TChar{});
+      for (auto &symbol : tail) {
+        symbol = _charset[_engine.Below(_charset.size())];
+      }
+      _group.push_back(std::move(tail));
+      Advance();
+    }
+    std::sort(_group.begin(), _group.end());
+  }
+
+  std::basic_string<TChar> _charset;
+  size_t _length;
+  Xoshiro256 _engine;
+  size_t _prefixLength{};
+  uint64_t _prefixSpace{};
+  uint64_t _prefixBegin{};
+  uint64_t _prefixWidth{};
+  size_t _count{};
+  size_t _left{};
+  double _logRest{};
+  bool _havePrefix{};
+  uint64_t _nextPrefix{};
+  uint64_t _groupPrefix{};
+  std::vector<std::basic_string<TChar>> _group;
+  size_t _groupNext{};
+};
+
+using SortedStringGenerator = SortedStringGeneratorBase<char>;
+using SortedStringGeneratorW = SortedStringGeneratorBase<wchar_t>;
+
+/**
+ * Read only view of the whole file, memory mapped where it is possible, so even corpora of several GB do not need to
+ * be read into memory before usage.
+ */
+class MappedFile
+{
+public:
+  explicit MappedFile(std::string const &path)
+  {
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("can not open " + path);
+    }
+    _buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    _data = _buffer.data();
+    _size = _buffer.size();
+#else
+    auto descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+      throw std::runtime_error("can not open " + path);
+    }
+    struct stat info = {};
+    if (fstat(descriptor, &info) != 0) {
+      close(descriptor);
+      throw std::runtime_error("can not get size of " + path);
+    }
+    _size = static_cast<size_t>(info.st_size);
+    if (_size > 0) {
+      auto mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (mapped == MAP_FAILED) {
+        close(descriptor);
+        throw std::runtime_error("can not map " + path);
+      }
+      // Everything will be read from the beginning to the end.
+      madvise(mapped, _size, MADV_SEQUENTIAL);
+      _data = static_cast<char const *>(mapped);
+    }
+    // Mapping stays valid after closing of the descriptor.
+    close(descriptor);
+#endif
+  }
+
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  ~MappedFile()
+  {
+#if !defined(_WIN32)
+    if (_size > 0) {
+      munmap(const_cast<char *>(_data), _size);
+    }
+#endif
+  }
+
+  auto data() const noexcept -> char const *
+  {
+    return _data;
+  }
+
+  auto size() const noexcept -> size_t
+  {
+    return _size;
+  }
+
+private:
+  char const *_data{};
+  size_t _size{};
+#if defined(_WIN32)
+  std::vector<char> _buffer;
+#endif
+};
+
+/**
+ * Bump arena for big generated outputs backed by huge pages, so multi GB fills have a lot less page faults and TLB
+ * misses. Explicit huge pages(MAP_HUGETLB) are tried first, they need pages reserved by the administrator, then
+ * transparent huge pages by madvise(MADV_HUGEPAGE), then ordinary pages.
+ * @note Memory is returned only all at once by Reset() or by the destructor.
+ */
+class HugePageArena
+{
+public:
+  enum class Backing
+  {
+    HugeTlb,
+    TransparentHugePages,
+    Regular,
+  };
+
+  static constexpr size_t kHugePageSize = 2 << 20;
+  static constexpr size_t kGigabytePageSize = 1 << 30;
+
+  /**
+   * @param capacity in bytes, it is rounded up to the size of the page which is really used
+   * @param gigabytePages 1GB explicit pages instead of 2MB ones
+   */
+  explicit HugePageArena(size_t capacity, bool gigabytePages = false)
+  {
+    capacity = std::max<size_t>(capacity, 1);
+#if !defined(_WIN32)
+    void *mapped = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    auto pageSize = gigabytePages ? kGigabytePageSize : kHugePageSize;
+    auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#if defined(MAP_HUGE_SHIFT)
+    flags |= (gigabytePages ? 30 : 21) << MAP_HUGE_SHIFT;
+#endif
+    _capacity = (capacity + pageSize - 1) / pageSize * pageSize;
+    mapped = mmap(nullptr, _capacity, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mapped != MAP_FAILED) {
+      _data = static_cast<char *>(mapped);
+      _mapped = _capacity;
+      _backing = Backing::HugeTlb;
+      return;
+    }
+#endif
+    // Without explicit huge pages the capacity is rounded only to the size of a transparent huge page.
+    _capacity = (capacity + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    // Additional huge page for alignment of the beginning, transparent huge pages need aligned 2MB ranges.
+    _mapped = _capacity + kHugePageSize;
+    mapped = mmap(nullptr, _mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    _base = static_cast<char *>(mapped);
+    auto address = reinterpret_cast<uintptr_t>(_base);
+    _data = _base + ((kHugePageSize - address % kHugePageSize) % kHugePageSize);
+#if defined(MADV_HUGEPAGE)
+    if (madvise(_data, _capacity, MADV_HUGEPAGE) == 0) {
+      _backing = Backing::TransparentHugePages;
+    }
+#endif
+#else
+    _capacity = (capacity + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    _buffer.reset(new char[_capacity]);
+    _data = _buffer.get();
+#endif
+  }
+
+  HugePageArena(HugePageArena const &) = delete;
+  HugePageArena &operator=(HugePageArena const &) = delete;
+
+  ~HugePageArena()
+  {
+#if !defined(_WIN32)
+    munmap(_base ? _base : _data, _mapped);
+#endif
+  }
+
+  /**
+   * @param size in bytes
+   * @param alignment power of two
+   * @return memory, it is not initialized
+   */
+  auto Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) -> void *
+  {
+    auto begin = (_used + alignment - 1) & ~(alignment - 1);
+    if (begin > _capacity || _capacity - begin < size) {
+      throw std::bad_alloc();
+    }
+    _used = begin + size;
+    return _data + begin;
+  }
+
+  /**
+   * Everything allocated before is released.
+   */
+  void Reset() noexcept
+  {
+    _used = 0;
+  }
+
+  auto Capacity() const noexcept -> size_t
+  {
+    return _capacity;
+  }
+
+  auto Used() const noexcept -> size_t
+  {
+    return _used;
+  }
+
+  auto GetBacking() const noexcept -> Backing
+  {
+    return _backing;
+  }
+
+private:
+  char *_data{};
+  char *_base{};
+  size_t _capacity{};
+  size_t _mapped{};
+  size_t _used{};
+  Backing _backing{Backing::Regular};
+#if defined(_WIN32)
+  std::unique_ptr<char[]> _buffer;
+#endif
+};
+
+/**
+ * Standard allocator from HugePageArena, for strings and vectors of get<T>(outSize, allocator).
+ * @note deallocate() does nothing, the memory goes back with the arena.
+ * @tparam T
+ */
+template<typename T>
+class ArenaAllocator
+{
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(HugePageArena &arena) noexcept
+      : _arena{&arena}
+  {
+  }
+
+  template<typename U>
+  ArenaAllocator(ArenaAllocator<U> const &other) noexcept
+      : _arena{other.Arena()}
+  {
+  }
+
+  auto allocate(size_t count) -> T *
+  {
+    return static_cast<T *>(_arena->Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, size_t) noexcept
+  {
+  }
+
+  auto Arena() const noexcept -> HugePageArena *
+  {
+    return _arena;
+  }
+
+  template<typename U>
+  auto operator==(ArenaAllocator<U> const &other) const noexcept -> bool
+  {
+    return _arena == other.Arena();
+  }
+
+  template<typename U>
+  auto operator!=(ArenaAllocator<U> const &other) const noexcept -> bool
+  {
+    return _arena != other.Arena();
+  }
+
+private:
+  HugePageArena *_arena;
+};
+
+/**
+ * Format preserving masking of existing text: every digit is replaced by a random digit, every lower case letter by a
+ * random lower case letter and every upper case letter by a random upper case one, everything else(punctuation,
+ * layout, UTF-8 multibyte sequences) is kept as is.
+ * @note Random values are a function of (seed, absolute position), so any part of a file can be masked independently,
+ * and threads can take different chunks. With a key the output is reproducible, without it the seed is taken from
+ * std::random_device.
+ */
+class FormatPreservingMasker
+{
+public:
+  static constexpr size_t kBlockSize = 4096;
+
+  /**
+   * @param key the same key and the same input give the same output, random masking without key
+   */
+  explicit FormatPreservingMasker(std::optional<uint64_t> key = std::nullopt)
+      : _seed{key ? *key : (uint64_t{std::random_device{}()} << 32) ^ std::random_device{}()}
+  {
+  }
+
+  /**
+   * Masking of a part of the input.
+   * @param in
+   * @param out can be the same as in
+   * @param size
+   * @param offset position of in from the beginning of the whole input
+   */
+  void Mask(char const *in, char *out, size_t size, uint64_t offset) const
+  {
+    uint16_t randoms[kBlockSize];
+    for (size_t done = 0; done < size;) {
+      auto block = (offset + done) / kBlockSize;
+      auto first = static_cast<size_t>((offset + done) % kBlockSize);
+      auto count = std::min(kBlockSize - first, size - done);
+      FillBlock(block, randoms);
+      MaskBlock(in + done, out + done, count, randoms + first);
+      done += count;
+    }
+  }
+
+  /**
+   * Masking of a stream, for pipes and anything which is not a file.
+   * @param in
+   * @param out
+   */
+  void MaskStream(std::istream &in, std::ostream &out) const
+  {
+    std::vector<char> buffer(kStreamBuffer);
+    uint64_t offset = 0;
+    while (in) {
+      in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      auto count = static_cast<size_t>(in.gcount());
+      Mask(buffer.data(), buffer.data(), count, offset);
+      out.write(buffer.data(), static_cast<std::streamsize>(count));
+      offset += count;
+    }
+  }
+
+  /**
+   * Masking of a file, the input is memory mapped, chunks are masked by threads and written in order.
+   * @param inputPath
+   * @param outputPath
+   * @param threads
+   */
+  void MaskFile(std::string const &inputPath, std::string const &outputPath, size_t threads = std::thread::hardware_concurrency()) const
+  {
+    MappedFile input(inputPath);
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      throw std::runtime_error("can not open " + outputPath);
+    }
+    threads = std::max<size_t>(threads, 1);
+    std::vector<std::vector<char>> buffers(threads, std::vector<char>(kFileChunk));
+    std::vector<size_t> sizes(threads);
+    for (size_t batch = 0; batch < input.size(); batch += threads * kFileChunk) {
+      std::vector<std::thread> workers;
+      for (size_t thread = 0; thread < threads; thread++) {
+        auto begin = std::min(input.size(), batch + thread * kFileChunk);
+        sizes[thread] = std::min(input.size() - begin, kFileChunk);
+        workers.emplace_back([&, thread, begin]() {
+          Mask(input.data() + begin, buffers[thread].data(), sizes[thread], begin);
+        });
+      }
+      for (auto &worker : workers) {
+        worker.join();
+      }
+      for (size_t thread = 0; thread < threads; thread++) {
+        output.write(buffers[thread].data(), static_cast<std::streamsize>(sizes[thread]));
+      }
+    }
+    if (!output) {
+      throw std::runtime_error("can not write " + outputPath);
+    }
+  }
+
+private:
+  static constexpr size_t kStreamBuffer = 1 << 20;
+  static constexpr size_t kFileChunk = 8 << 20;
+
+  void FillBlock(uint64_t block, uint16_t *randoms) const noexcept
+  {
+    Xoshiro256 engine(SplitMix64(_seed ^ SplitMix64(block)));
+    for (size_t i = 0; i < kBlockSize; i += 4) {
+      auto word = engine.Next();
+      std::memcpy(randoms + i, &word, sizeof(word));
+    }
+  }
+
+  static void MaskBlock(char const *in, char *out, size_t count, uint16_t const *randoms) noexcept
+  {
+    // Classification and replacement without branches, so the loop is vectorized.
+    for (size_t i = 0; i < count; i++) {
+      auto symbol = static_cast<unsigned char>(in[i]);
+      uint32_t random = randoms[i];
+      auto digit = static_cast<unsigned char>('0' + ((random * 10) >> 16));
+      auto lower = static_cast<unsigned char>('a' + ((random * 26) >> 16));
+      auto upper = static_cast<unsigned char>('A' + ((random * 26) >> 16));
+      auto isDigit = static_cast<unsigned char>(symbol - '0') < 10;
+      auto isLower = static_cast<unsigned char>(symbol - 'a') < 26;
+      auto isUpper = static_cast<unsigned char>(symbol - 'A') < 26;
+      symbol = isDigit ? digit : symbol;
+      symbol = isLower ? lower : symbol;
+      symbol = isUpper ? upper : symbol;
+      out[i] = static_cast<char>(symbol);
+    }
+  }
+
+  uint64_t _seed;
+};
+
+/**
+ * Order-k Markov model of bytes, it is trained from a sample corpus and then generates strings which look like the
+ * corpus: the same frequencies of symbols and of sequences of up to k + 1 symbols. Uniform strings compress and hash
+ * very different from the real keys and names, so this one should be used where it matters.
+ * @note Every context has its own alias table, all of them are kept in a few flat arrays. If some context was never
+ * followed by anything in the corpus, the next symbol is taken by the frequencies of single symbols.
+ */
+class MarkovStringGenerator
+{
+public:
+  /**
+   * @param order length of the context, up to 7, because context and the next symbol are packed in 64 bits.
+   * @param seed
+   * @param rand
+   */
+  explicit MarkovStringGenerator(
+    size_t order,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : _order{order}, _seed{std::move(seed)}, _rand{std::move(rand)}
+  {
+    if (_order > kMaxOrder) {
+      throw std::invalid_argument("order of the model should not be more than 7");
+    }
+    _contextMask = (uint64_t{1} << (8 * _order)) - 1;
+#if !SPEEDUP_GENERATOR_BY_DEDICATED_CALL_OF_SEED_RANDOM
+    static std::once_flag flag;
+    std::call_once(flag, [&]() { Seed(); });
+#endif
+  }
+
+  /**
+   * Training from a file, the file is memory mapped.
+   * @param path
+   * @param threads
+   */
+  void TrainFromFile(std::string const &path, size_t threads = std::thread::hardware_concurrency())
+  {
+    MappedFile file(path);
+    Train(file.data(), file.size(), threads);
+  }
+
+  /**
+   * Training from memory, previous model is replaced. Corpus is split between threads, every thread counts its own part
+   * and results are merged at the end.
+   * @param corpus
+   * @param corpusSize should be more than order
+   * @param threads
+   */
+  void Train(char const *corpus, size_t corpusSize, size_t threads = std::thread::hardware_concurrency())
+  {
+    if (corpusSize <= _order) {
+      throw std::invalid_argument("corpus should be longer than the order of the model");
+    }
+    threads = std::max<size_t>(1, std::min(threads, (corpusSize - _order) / kMinimalChunk + 1));
+
+    std::vector<Counts> counts(threads);
+    std::vector<std::thread> workers;
+    auto chunk = (corpusSize - _order + threads - 1) / threads;
+    for (size_t thread = 0; thread < threads; thread++) {
+      auto begin = _order + thread * chunk;
+      auto end = std::min(corpusSize, begin + chunk);
+      workers.emplace_back([this, corpus, begin, end, &counts = counts[thread]]() {
+        Count(corpus, begin, end, counts);
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    for (size_t thread = 1; thread < threads; thread++) {
+      for (auto const &item : counts[thread].transitions) {
+        counts[0].transitions[item.first] += item.second;
+      }
+      for (size_t symbol = 0; symbol < 256; symbol++) {
+        counts[0].symbols[symbol] += counts[thread].symbols[symbol];
+      }
+    }
+    Build(counts[0]);
+  }
+
+  /**
+   * Helper for returning result in some container like vector or string.
+   * @tparam T
+   * @param outSize
+   * @return
+   */
+  template<typename T>
+  auto get(size_t outSize) -> T
+  {
+    T result(outSize, {});
+    get(result.data(), result.size());
+    return result;
+  }
+
+  /**
+   * The same interface as RandomStringGeneratorBase has, every call starts from a random context of the corpus.
+   * @param out
+   * @param outSize
+   */
+  void get(char *out, size_t outSize)
+  {
+    if (_contexts.empty()) {
+      throw std::logic_error("model should be trained before generation");
+    }
+    auto context = _contexts[Sample(_startThresholds.data(), _startAliases.data(), _contexts.size())].first;
+    for (size_t i = 0; i < outSize; i++) {
+      auto found = std::lower_bound(_contexts.begin(), _contexts.end(), std::make_pair(context, Table{}), [](auto const &lhs, auto const &rhs) {
+        return lhs.first < rhs.first;
+      });
+      unsigned char symbol;
+      if (found != _contexts.end() && found->first == context) {
+        auto const &table = found->second;
+        symbol = _symbols[table.offset + Sample(&_thresholds[table.offset], &_aliases[table.offset], table.size)];
+      } else {
+        symbol = static_cast<unsigned char>(Sample(_fallbackThresholds.data(), _fallbackAliases.data(), 256));
+      }
+      out[i] = static_cast<char>(symbol);
+      context = ((context << 8) | symbol) & _contextMask;
+    }
+  }
+
+  /**
+   * Manual asking seeding.
+   */
+  void Seed()
+  {
+    _seed();
+  }
+
+private:
+  static constexpr size_t kMaxOrder = 7;
+  static constexpr size_t kMinimalChunk = 1 << 20;
+
+  struct Counts
+  {
+    std::unordered_map<uint64_t, uint64_t> transitions;
+    uint64_t symbols[256] = {};
+  };
+
+  struct Table
+  {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  void Count(char const *corpus, size_t begin, size_t end, Counts &counts) const
+  {
+    auto const *bytes = reinterpret_cast<unsigned char const *>(corpus);
+    uint64_t context = 0;
+    for (auto i = begin - _order; i < begin; i++) {
+      context = (context << 8) | bytes[i];
+    }
+    for (auto i = begin; i < end; i++) {
+      context &= _contextMask;
+      counts.transitions[(context << 8) | bytes[i]]++;
+      counts.symbols[bytes[i]]++;
+      context = (context << 8) | bytes[i];
+    }
+  }
+
+  void Build(Counts const &counts)
+  {
+    std::vector<std::pair<uint64_t, uint64_t>> transitions(counts.transitions.begin(), counts.transitions.end());
+    std::sort(transitions.begin(), transitions.end());
+
+    _contexts.clear();
+    _symbols.clear();
+    _symbols.reserve(transitions.size());
+    std::vector<double> weights;
+    weights.reserve(transitions.size());
+    std::vector<double> contextWeights;
+    for (auto const &transition : transitions) {
+      auto context = transition.first >> 8;
+      if (_contexts.empty() || _contexts.back().first != context) {
+        _contexts.emplace_back(context, Table{static_cast<uint32_t>(_symbols.size()), 0});
+        contextWeights.push_back(0);
+      }
+      _contexts.back().second.size++;
+      contextWeights.back() += static_cast<double>(transition.second);
+      _symbols.push_back(static_cast<unsigned char>(transition.first & 0xFF));
+      weights.push_back(static_cast<double>(transition.second));
+    }
+
+    _thresholds.resize(_symbols.size());
+    _aliases.resize(_symbols.size());
+    for (auto const &item : _contexts) {
+      auto const &table = item.second;
+      BuildAliasTable(&weights[table.offset], table.size, &_thresholds[table.offset], &_aliases[table.offset]);
+    }
+    _startThresholds.resize(_contexts.size());
+    _startAliases.resize(_contexts.size());
+    BuildAliasTable(contextWeights.data(), contextWeights.size(), _startThresholds.data(), _startAliases.data());
+
+    double symbolWeights[256];
+    for (size_t symbol = 0; symbol < 256; symbol++) {
+      symbolWeights[symbol] = static_cast<double>(counts.symbols[symbol]);
+    }
+    _fallbackThresholds.resize(256);
+    _fallbackAliases.resize(256);
+    BuildAliasTable(symbolWeights, 256, _fallbackThresholds.data(), _fallbackAliases.data());
+  }
+
+  auto Sample(uint32_t const *thresholds, uint32_t const *aliases, size_t size) -> uint32_t
+  {
+    auto column = static_cast<uint32_t>(_rand(size));
+    return AliasCoin(_rand) < thresholds[column] ? column : aliases[column];
+  }
+
+  size_t _order;
+  uint64_t _contextMask;
+  std::function<void()> _seed;
+  std::function<size_t(size_t)> _rand;
+  // Sorted by context, so the model has not any pointers inside and lookup is a binary search.
+  std::vector<std::pair<uint64_t, Table>> _contexts;
+  std::vector<unsigned char> _symbols;
+  std::vector<uint32_t> _thresholds;
+  std::vector<uint32_t> _aliases;
+  std::vector<uint32_t> _startThresholds;
+  std::vector<uint32_t> _startAliases;
+  std::vector<uint32_t> _fallbackThresholds;
+  std::vector<uint32_t> _fallbackAliases;
+};
+
+/**
+ * Compiled pattern like [A-Z]{3}-[0-9]{4}-[a-f0-9]{8}, it is a list of segments: runs of symbols from one charset and
+ * literals. The plan is immutable, so one plan can be shared between any amount of generators and threads.
+ * Supported syntax: [...] with single symbols and ranges like a-z, {n} repeats the previous symbol or set, \ escapes
+ * the next symbol, everything else is a literal.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class PatternPlanBase
+{
+public:
+  struct Segment
+  {
+    // Charset of the run, or the text itself for literals.
+    std::basic_string<TChar> symbols;
+    size_t count;
+    bool literal;
+  };
+
+  /**
+   * Compiled plans are cached by the pattern, so it is cheap to compile the same pattern in a lot of places.
+   * @param pattern
+   * @return
+   */
+  static auto Compile(std::basic_string<TChar> const &pattern) -> std::shared_ptr<PatternPlanBase const>
+  {
+    static std::mutex mutex;
+    static std::map<std::basic_string<TChar>, std::shared_ptr<PatternPlanBase const>> cache;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &plan = cache[pattern];
+    if (!plan) {
+      plan = std::make_shared<PatternPlanBase const>(pattern);
+    }
+    return plan;
+  }
+
+  /**
+   * Parsing without the cache.
+   * @param pattern
+   */
+  explicit PatternPlanBase(std::basic_string<TChar> const &pattern)
+  {
+    size_t position = 0;
+    while (position < pattern.size()) {
+      Segment segment{{}, 1, true};
+      if (pattern[position] == TChar('[')) {
+        segment.literal = false;
+        segment.symbols = ParseSet(pattern, position);
+      } else {
+        if (pattern[position] == TChar('\\')) {
+          position++;
+        }
+        if (position == pattern.size()) {
+          throw std::invalid_argument("pattern should not end with escape");
+        }
+        segment.symbols.push_back(pattern[position++]);
+      }
+      if (position < pattern.size() && pattern[position] == TChar('{')) {
+        segment.count = ParseCount(pattern, position);
+      }
+      Append(std::move(segment));
+    }
+  }
+
+  /**
+   * Length of every generated string.
+   * @return
+   */
+  auto Size() const noexcept -> size_t
+  {
+    return _size;
+  }
+
+  auto Segments() const noexcept -> std::vector<Segment> const &
+  {
+    return _segments;
+  }
+
+private:
+  static auto ParseSet(std::basic_string<TChar> const &pattern, size_t &position) -> std::basic_string<TChar>
+  {
+    std::basic_string<TChar> charset;
+    position++;
+    while (position < pattern.size() && pattern[position] != TChar(']')) {
+      if (pattern[position] == TChar('\\')) {
+        position++;
+      }
+      if (position == pattern.size()) {
+        break;
+      }
+      auto first = pattern[position++];
+      if (position + 1 < pattern.size() && pattern[position] == TChar('-') && pattern[position + 1] != TChar(']')) {
+        auto last = pattern[position + 1];
+        position += 2;
+        if (last < first) {
+          throw std::invalid_argument("range in the pattern should not be reversed");
+        }
+        for (auto symbol = first; symbol != last; symbol++) {
+          charset.push_back(symbol);
+        }
+        charset.push_back(last);
+      } else {
+        charset.push_back(first);
+      }
+    }
+    if (position == pattern.size()) {
+      throw std::invalid_argument("set in the pattern is not closed");
+    }
+    position++;
+    if (charset.empty()) {
+      throw std::invalid_argument("set in the pattern should not be empty");
+    }
+    return charset;
+  }
+
+  static auto ParseCount(std::basic_string<TChar> const &pattern, size_t &position) -> size_t
+  {
+    size_t count = 0;
+    position++;
+    auto begin = position;
+    while (position < pattern.size() && pattern[position] >= TChar('0') && pattern[position] <= TChar('9')) {
+      count = count * 10 + static_cast<size_t>(pattern[position++] - TChar('0'));
+    }
+    if (position == begin || position == pattern.size() || pattern[position] != TChar('}')) {
+      throw std::invalid_argument("repetition in the pattern should look like {n}");
+    }
+    position++;
+    return count;
+  }
+
+  void Append(Segment segment)
+  {
+    if (segment.count == 0) {
+      return;
+    }
+    _size += segment.count * (segment.literal ? segment.symbols.size() : 1);
+    if (segment.literal) {
+      // Literals are expanded and merged, so they are copied by one call.
+      std::basic_string<TChar> text;
+      for (size_t i = 0; i < segment.count; i++) {
+        text += segment.symbols;
+      }
+      if (!_segments.empty() && _segments.back().literal) {
+        _segments.back().symbols += text;
+        _segments.back().count = _segments.back().symbols.size();
+        return;
+      }
+      segment.symbols = std::move(text);
+      segment.count = segment.symbols.size();
+    }
+    _segments.push_back(std::move(segment));
+  }
+
+  std::vector<Segment> _segments;
+  size_t _size{};
+};
+
+using PatternPlan = PatternPlanBase<char>;
+using PatternPlanW = PatternPlanBase<wchar_t>;
+
+/**
+ * Executes a compiled plan, every run of the plan is written by the bulk RandomStringGeneratorBase::get directly into
+ * the output, so there is not any allocation per segment and not any concatenation.
+ * @note Plan can be shared, but generator should be used only by one thread at a time, as any other generator.
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class PatternStringGeneratorBase
+{
+public:
+  PatternStringGeneratorBase(
+    std::shared_ptr<PatternPlanBase<TChar> const> plan,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : _plan{std::move(plan)}
+  {
+    for (auto const &segment : _plan->Segments()) {
+      if (!segment.literal) {
+        _runs.emplace_back(segment.symbols, seed, rand);
+      }
+    }
+  }
+
+  /**
+   * Helper which compiles(or takes from the cache) the pattern.
+   * @param pattern
+   * @param seed
+   * @param rand
+   */
+  PatternStringGeneratorBase(
+    TChar const *pattern,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : PatternStringGeneratorBase<TChar>(PatternPlanBase<TChar>::Compile(pattern), std::move(seed), std::move(rand))
+  {
+  }
+
+  /**
+   * Length of every generated string.
+   * @return
+   */
+  auto Size() const noexcept -> size_t
+  {
+    return _plan->Size();
+  }
+
+  /**
+   * Helper for returning result in some container like vector or string.
+   * @tparam T
+   * @return
+   */
+  template<typename T>
+  auto get() -> T
+  {
+    T result(Size(), {});
+    get(result.data());
+    return result;
+  }
+
+  /**
+   * @param out should have space for Size() symbols
+   */
+  void get(TChar *out)
+  {
+    auto run = _runs.begin();
+    for (auto const &segment : _plan->Segments()) {
+      if (segment.literal) {
+        std::copy(segment.symbols.begin(), segment.symbols.end(), out);
+      } else {
+        (run++)->get(out, segment.count);
+      }
+      out += segment.count;
+    }
+  }
+
+private:
+  std::shared_ptr<PatternPlanBase<TChar> const> _plan;
+  std::vector<RandomStringGeneratorBase<TChar>> _runs;
+};
+
+using PatternStringGenerator = PatternStringGeneratorBase<char>;
+using PatternStringGeneratorW = PatternStringGeneratorBase<wchar_t>;
+
+/**
+ * Generation of structured strings by a context free grammar, for example:
+ *   <expr> ::= <term> | <expr> "+" <term>
+ *   <term> ::= "x" | "(" <expr> ")"
+ * Every line is a rule, alternatives are separated by |, terminals are in quotes(\ escapes the next symbol), the first
+ * rule is the start. The grammar is compiled once into flat tables of rules, alternatives and terminals, expansion goes
+ * by an explicit stack which is reused, so steady state generation does not allocate anything.
+ * @note Every rule knows its minimal depth, and alternatives which can not be finished in the remaining depth are not
+ * chosen, so the depth is always bounded by max(maxDepth, minimal depth of the start rule).
+ * @tparam TChar character can be different.
+ */
+template<typename TChar>
+class GrammarStringGeneratorBase
+{
+public:
+  /**
+   * @param grammar
+   * @param maxDepth
+   * @param seed
+   * @param rand
+   */
+  GrammarStringGeneratorBase(
+    std::basic_string<TChar> const &grammar,
+    size_t maxDepth,
+    std::function<void()> seed = []() { srand(time(nullptr)); },
+    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
+      : _maxDepth{maxDepth}, _seed{std::move(seed)}, _rand{std::move(rand)}
+  {
+    Parse(grammar);
+    ComputeDepths();
+#if !SPEEDUP_GENERATOR_BY_DEDICATED_CALL_OF_SEED_RANDOM
+    static std::once_flag flag;
+    std::call_once(flag, [&]() { Seed(); });
+#endif
+  }
+
+  /**
+   * Helper for returning result in some container like vector or string.
+   * @tparam T
+   * @return
+   */
+  template<typename T>
+  auto get() -> T
+  {
+    T result;
+    Expand([&](TChar const *text, size_t size) {
+      result.insert(result.end(), text, text + size);
+      return true;
+    });
+    return result;
+  }
+
+  /**
+   * Appends the next string to the arena, so a lot of strings can be kept in one buffer.
+   * @param arena
+   * @return size of the appended string
+   */
+  auto get(std::basic_string<TChar> &arena) -> size_t
+  {
+    auto before = arena.size();
+    Expand([&](TChar const *text, size_t size) {
+      arena.append(text, size);
+      return true;
+    });
+    return arena.size() - before;
+  }
+
+  /**
+   * The same interface as RandomStringGeneratorBase has, the string is cut if it does not fit.
+   * @param out
+   * @param outSize
+   * @return amount of written symbols
+   */
+  auto get(TChar *out, size_t outSize) -> size_t
+  {
+    size_t written = 0;
+    Expand([&](TChar const *text, size_t size) {
+      auto count = std::min(size, outSize - written);
+      std::copy(text, text + count, out + written);
+      written += count;
+      return written < outSize;
+    });
+    return written;
+  }
+
+  /**
+   * Manual asking seeding.
+   */
+  void Seed()
+  {
+    _seed();
+  }
+
+private:
+  static constexpr size_t kInfiniteDepth = std::numeric_limits<size_t>::max();
+
+  struct Rule
+  {
+    std::basic_string<TChar> name;
+    size_t firstAlternative;
+    size_t alternativeCount;
+    size_t depth;
+  };
+
+  struct Alternative
+  {
+    size_t offset;
+    size_t size;
+    size_t depth;
+  };
+
+  struct Terminal
+  {
+    size_t offset;
+    size_t size;
+  };
+
+  struct Frame
+  {
+    size_t next;
+    size_t end;
+    size_t depth;
+  };
+
+  // Terminals are negative, -(index + 1), rules are their indexes.
+  using Symbol = std::ptrdiff_t;
+
+  static auto IsSpace(TChar symbol) -> bool
+  {
+    return symbol == TChar(' ') || symbol == TChar('\t') || symbol == TChar('\r');
+  }
+
+  auto RuleIndex(std::basic_string<TChar> const &name) -> size_t
+  {
+    auto found = std::find_if(_rules.begin(), _rules.end(), [&](Rule const &rule) { return rule.name == name; });
+    if (found != _rules.end()) {
+      return static_cast<size_t>(found - _rules.begin());
+    }
+    _rules.push_back(Rule{name, 0, 0, kInfiniteDepth});
+    return _rules.size() - 1;
+  }
+
+  void Parse(std::basic_string<TChar> const &grammar)
+  {
+    // Alternatives of every rule are collected first, and laid out rule by rule at the end.
+    std::vector<std::vector<std::vector<Symbol>>> definitions;
+    std::vector<bool> defined;
+    size_t position = 0;
+    auto skipSpaces = [&]() {
+      while (position < grammar.size() && IsSpace(grammar[position])) {
+        position++;
+      }
+    };
+    auto parseName = [&]() {
+      auto end = grammar.find(TChar('>'), position);
+      if (end == std::basic_string<TChar>::npos || grammar[position] != TChar('<')) {
+        throw std::invalid_argument("rule name should look like <name>");
+      }
+      auto index = RuleIndex(grammar.substr(position + 1, end - position - 1));
+      position = end + 1;
+      definitions.resize(_rules.size());
+      defined.resize(_rules.size());
+      return index;
+    };
+
+    while (position < grammar.size()) {
+      skipSpaces();
+      if (position < grammar.size() && grammar[position] == TChar('\n')) {
+        position++;
+        continue;
+      }
+      if (position == grammar.size()) {
+        break;
+      }
+      auto rule = parseName();
+      if (defined[rule]) {
+        throw std::invalid_argument("rule should be defined only once, use | for alternatives");
+      }
+      defined[rule] = true;
+      skipSpaces();
+      auto const assignment = std::basic_string<TChar>{TChar(':'), TChar(':'), TChar('=')};
+      if (grammar.compare(position, assignment.size(), assignment) != 0) {
+        throw std::invalid_argument("rule name should be followed by ::=");
+      }
+      position += assignment.size();
+      definitions[rule].emplace_back();
+      while (true) {
+        skipSpaces();
+        if (position == grammar.size() || grammar[position] == TChar('\n')) {
+          break;
+        }
+        auto symbol = grammar[position];
+        if (symbol == TChar('|')) {
+          position++;
+          definitions[rule].emplace_back();
+        } else if (symbol == TChar('<')) {
+          auto index = static_cast<Symbol>(parseName());
+          definitions[rule].back().push_back(index);
+        } else if (symbol == TChar('"') || symbol == TChar('\'')) {
+          auto offset = _text.size();
+          position++;
+          while (position < grammar.size() && grammar[position] != symbol) {
+            if (grammar[position] == TChar('\\') && position + 1 < grammar.size()) {
+              position++;
+            }
+            _text.push_back(grammar[position++]);
+          }
+          if (position == grammar.size()) {
+            throw std::invalid_argument("terminal is not closed");
+          }
+          position++;
+          if (_text.size() > offset) {
+            _terminals.push_back(Terminal{offset, _text.size() - offset});
+            definitions[rule].back().push_back(-static_cast<Symbol>(_terminals.size()));
+          }
+        } else {
+          throw std::invalid_argument("unexpected symbol in the grammar");
+        }
+      }
+    }
+    if (_rules.empty()) {
+      throw std::invalid_argument("grammar should have at least one rule");
+    }
+    for (size_t rule = 0; rule < _rules.size(); rule++) {
+      if (!defined[rule]) {
+        throw std::invalid_argument("rule is used but not defined");
+      }
+      _rules[rule].firstAlternative = _alternatives.size();
+      _rules[rule].alternativeCount = definitions[rule].size();
+      for (auto const &alternative : definitions[rule]) {
+        _alternatives.push_back(Alternative{_symbols.size(), alternative.size(), kInfiniteDepth});
+        _symbols.insert(_symbols.end(), alternative.begin(), alternative.end());
+      }
+    }
+  }
+
+  void ComputeDepths()
+  {
+    // Fixed point: depth of an alternative is the deepest of its rules, depth of a rule is 1 + its shallowest alternative.
+    for (auto changed = true; changed;) {
+      changed = false;
+      for (auto &rule : _rules) {
+        for (size_t i = 0; i < rule.alternativeCount; i++) {
+          auto &alternative = _alternatives[rule.firstAlternative + i];
+          size_t depth = 0;
+          for (size_t j = 0; j < alternative.size; j++) {
+            auto symbol = _symbols[alternative.offset + j];
+            if (symbol >= 0) {
+              depth = std::max(depth, _rules[symbol].depth);
+            }
+          }
+          alternative.depth = depth;
+          if (depth != kInfiniteDepth && depth + 1 < rule.depth) {
+            rule.depth = depth + 1;
+            changed = true;
+          }
+        }
+      }
+    }
+    for (auto &rule : _rules) {
+      if (rule.depth == kInfiniteDepth) {
+        throw std::invalid_argument("rule <" + std::string(rule.name.begin(), rule.name.end()) + "> can not be finished");
+      }
+      // Shallow alternatives first, so alternatives which fit in any depth are always a prefix.
+      std::stable_sort(_alternatives.begin() + rule.firstAlternative,
+                       _alternatives.begin() + rule.firstAlternative + rule.alternativeCount,
+                       [](Alternative const &lhs, Alternative const &rhs) { return lhs.depth < rhs.depth; });
+    }
+  }
+
+  template<typename Sink>
+  void Expand(Sink &&sink)
+  {
+    _stack.clear();
+    Push(0, std::max(_maxDepth, _rules.front().depth));
+    while (!_stack.empty()) {
+      auto &frame = _stack.back();
+      if (frame.next == frame.end) {
+        _stack.pop_back();
+        continue;
+      }
+      auto symbol = _symbols[frame.next++];
+      if (symbol < 0) {
+        auto const &terminal = _terminals[-symbol - 1];
+        if (!sink(_text.data() + terminal.offset, terminal.size)) {
+          return;
+        }
+      } else {
+        Push(static_cast<size_t>(symbol), frame.depth);
+      }
+    }
+  }
+
+  void Push(size_t ruleIndex, size_t depth)
   {
-#if !SPEEDUP_GENERATOR_BY_DEDICATED_CALL_OF_SEED_RANDOM
-    // A lot of people thought that atomic very fast. In computers with 128 cores implementation which uses atomics
-    // can slow down compared to 32 cores etc. The problem is in the nature of atomic cpu core hardware implementation.
-    // So I have just shown that this is not a good idea but, it is helpful do not care about it some time.
-    static std::once_flag flag;
-    std::call_once(flag, [&]() {
-      // this every time passed by copy, so I do not see any problems to use & to avoid exercises around changing this
-      // in the future. The main fail of interviewers that = means everything copy from scope(only that one which was
-      // used in the lambda), and & everything will be copied by reference(it is not true, because this will be copied by value)
-      Seed();
+    auto const &rule = _rules[ruleIndex];
+    auto first = _alternatives.begin() + rule.firstAlternative;
+    auto fitting = std::upper_bound(first, first + rule.alternativeCount, depth - 1, [](size_t value, Alternative const &alternative) {
+      return value < alternative.depth;
     });
-#endif
+    auto const &alternative = *(first + _rand(fitting - first));
+    _stack.push_back(Frame{alternative.offset, alternative.offset + alternative.size, depth - 1});
   }
 
+  size_t _maxDepth;
+  std::function<void()> _seed;
+  std::function<size_t(size_t)> _rand;
+  std::vector<Rule> _rules;
+  std::vector<Alternative> _alternatives;
+  std::vector<Symbol> _symbols;
+  std::vector<Terminal> _terminals;
+  std::basic_string<TChar> _text;
+  std::vector<Frame> _stack;
+};
+
+using GrammarStringGenerator = GrammarStringGeneratorBase<char>;
+using GrammarStringGeneratorW = GrammarStringGeneratorBase<wchar_t>;
+
+/**
+ * Generator of UTF-8(char) or UTF-16(char16_t) strings from a set of code points without any wide intermediate string
+ * and without any conversion pass. Every symbol is encoded once in the constructor into a fixed width entry of the
+ * table, so the generation is only copying of entries. Symbols out of BMP are surrogate pairs in UTF-16, and they are
+ * still one symbol of the charset.
+ * @note When the symbols have different widths, every entry is copied whole and the output pointer is moved by the
+ * real width of the symbol, so there are no branches on the width.
+ * @tparam TCodeUnit char for UTF-8 or char16_t for UTF-16
+ */
+template<typename TCodeUnit>
+class EncodedStringGeneratorBase
+{
+public:
   /**
-   * Helper for usage arrays and avoid doing size calculation on the client code side.
-   * @note due to C++ language allow to init an arrays with const char sequence pointer,
-   * you should understand that \0 will be in the end, and C++ can not care about it,
-   * so use for this purpose constructor which gets TChar const* instead.
-   * @param charsetArray
+   * @param codePoints all of them should be valid Unicode scalar values
    * @param seed
    * @param rand
    */
-  template<size_t size>
-  RandomStringGeneratorBase(
-    TChar const (&charsetArray)[size],
+  EncodedStringGeneratorBase(
+    std::u32string const &codePoints,
     std::function<void()> seed = []() { srand(time(nullptr)); },
     std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
-      : RandomStringGeneratorBase<TChar>(std::basic_string<TChar>(charsetArray, charsetArray + size),
-                                         std::move(seed),
-                                         std::move(rand))
+      : _seed{std::move(seed)}, _rand{std::move(rand)}
   {
+    if (codePoints.empty()) {
+      throw std::invalid_argument("charset should not be empty");
+    }
+    _entries.reserve(codePoints.size());
+    _widths.reserve(codePoints.size());
+    for (auto codePoint : codePoints) {
+      Entry entry = {};
+      auto width = Encode(codePoint, entry.units);
+      _entries.push_back(entry);
+      _widths.push_back(static_cast<unsigned char>(width));
+      _minWidth = std::min(_minWidth, width);
+      _maxWidth = std::max(_maxWidth, width);
+    }
+#if !SPEEDUP_GENERATOR_BY_DEDICATED_CALL_OF_SEED_RANDOM
+    static std::once_flag flag;
+    std::call_once(flag, [&]() { Seed(); });
+#endif
   }
 
   /**
-   * Helper to use const strings.
-   * @tparam size
-   * @param charsetArray
+   * Helper to use const strings like U"абв".
+   * @param codePoints
    * @param seed
    * @param rand
    */
-  RandomStringGeneratorBase(
-    TChar const *charsetString,
+  EncodedStringGeneratorBase(
+    char32_t const *codePoints,
     std::function<void()> seed = []() { srand(time(nullptr)); },
     std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
-      : RandomStringGeneratorBase<TChar>(std::basic_string<TChar>(charsetString),
-                                          std::move(seed),
-                                          std::move(rand))
+      : EncodedStringGeneratorBase(std::u32string(codePoints), std::move(seed), std::move(rand))
   {
   }
 
   /**
-   * Generic helper constructor for any kind of random access iterator containers.
-   * @tparam Container it can be std::vector or std::string for example
-   * @param charset
-   * @param seed
-   * @param rand
+   * Maximal amount of code units per symbol, output buffer for n symbols should have n * MaxWidth() code units.
+   * @return
    */
-  template<typename Container,
-           typename std::enable_if<HaveRandomAccessIterator<Container>::value>::type * = nullptr>
-  RandomStringGeneratorBase(
-    Container charset,
-    std::function<void()> seed = []() { srand(time(nullptr)); },
-    std::function<size_t(size_t)> rand = [](size_t range) { return std::rand() % range; })
-      : RandomStringGeneratorBase<TChar>(std::basic_string<TChar>(charset.data(), charset.data() + charset.size()),
-                                         std::move(seed),
-                                         std::move(rand))
+  auto MaxWidth() const noexcept -> size_t
   {
+    return _maxWidth;
   }
 
   /**
    * Helper for returning result in some container like vector or string.
    * @tparam T
-   * @param outSize
+   * @param symbols amount of symbols, not code units
    * @return
    */
   template<typename T>
-  auto get(size_t outSize) -> T
+  auto get(size_t symbols) -> T
   {
-    T result(outSize, {});
-    get(result.data(), result.size());
+    T result(symbols * _maxWidth, {});
+    result.resize(get(result.data(), symbols));
     return result;
   }
 
   /**
-   * Very efficient implementation but not very safe due to some preconditions should be checked on the client code side.
-   * @tparam TChar
-   * @param out
-   * @param outSize
+   * @param out should have space for symbols * MaxWidth() code units
+   * @param symbols amount of symbols, not code units
+   * @return amount of written code units
    */
-  void get(TChar *out, size_t outSize)
+  auto get(TCodeUnit *out, size_t symbols) -> size_t
   {
-    // This loop will be optimized, so should not be used any handwritten pointer tricks...
-    for (int i = 0; i < outSize; i++) {
-      out[i] = _charset[_rand(_charset.size())];
+    constexpr size_t kBlockSize = 256;
+    uint32_t indexes[kBlockSize];
+    auto begin = out;
+    for (size_t done = 0; done < symbols; done += kBlockSize) {
+      auto count = std::min(kBlockSize, symbols - done);
+      for (size_t i = 0; i < count; i++) {
+        indexes[i] = static_cast<uint32_t>(_rand(_entries.size()));
+      }
+      if (_minWidth == _maxWidth) {
+        out = CopyFixed(indexes, count, out);
+        continue;
+      }
+      // Copying of whole entries can write after the end only for the last kMaxWidth - 1 symbols.
+      auto tail = kMaxWidth - 1;
+      auto safe = (done + count + tail <= symbols) ? count : (symbols > done + tail ? symbols - done - tail : 0);
+      for (size_t i = 0; i < safe; i++) {
+        std::memcpy(out, _entries[indexes[i]].units, sizeof(Entry));
+        out += _widths[indexes[i]];
+      }
+      for (size_t i = safe; i < count; i++) {
+        std::memcpy(out, _entries[indexes[i]].units, _widths[indexes[i]] * sizeof(TCodeUnit));
+        out += _widths[indexes[i]];
+      }
     }
+    return static_cast<size_t>(out - begin);
   }
 
   /**
@@ -151,14 +4325,91 @@ public:
   }
 
 private:
-  std::basic_string<TChar> _charset;
+  static_assert(sizeof(TCodeUnit) <= 2, "only UTF-8 and UTF-16 code units are supported, UTF-32 does not need encoding");
+
+  static constexpr size_t kMaxWidth = 4 / sizeof(TCodeUnit);
+
+  struct Entry
+  {
+    TCodeUnit units[kMaxWidth];
+  };
+
+  static auto Encode(char32_t codePoint, char16_t *units) -> size_t
+  {
+    if (codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+      throw std::invalid_argument("code point is not a Unicode scalar value");
+    }
+    if (codePoint < 0x10000) {
+      units[0] = static_cast<char16_t>(codePoint);
+      return 1;
+    }
+    codePoint -= 0x10000;
+    units[0] = static_cast<char16_t>(0xD800 | (codePoint >> 10));
+    units[1] = static_cast<char16_t>(0xDC00 | (codePoint & 0x3FF));
+    return 2;
+  }
+
+  static auto Encode(char32_t codePoint, char *units) -> size_t
+  {
+    if (codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+      throw std::invalid_argument("code point is not a Unicode scalar value");
+    }
+    if (codePoint < 0x80) {
+      units[0] = static_cast<char>(codePoint);
+      return 1;
+    }
+    if (codePoint < 0x800) {
+      units[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+      units[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+      return 2;
+    }
+    if (codePoint < 0x10000) {
+      units[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+      units[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+      units[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+      return 3;
+    }
+    units[0] = static_cast<char>(0xF0 | (codePoint >> 18));
+    units[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+    units[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+    units[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+    return 4;
+  }
+
+  template<size_t width>
+  static auto CopyFixed(Entry const *entries, uint32_t const *indexes, size_t count, TCodeUnit *out) -> TCodeUnit *
+  {
+    // Width is a constant inside of the loop, so every copy is one load and one store.
+    for (size_t i = 0; i < count; i++, out += width) {
+      std::memcpy(out, entries[indexes[i]].units, width * sizeof(TCodeUnit));
+    }
+    return out;
+  }
+
+  auto CopyFixed(uint32_t const *indexes, size_t count, TCodeUnit *out) const -> TCodeUnit *
+  {
+    switch (_maxWidth) {
+      case 1:
+        return CopyFixed<1>(_entries.data(), indexes, count, out);
+      case 2:
+        return CopyFixed<2>(_entries.data(), indexes, count, out);
+      case 3:
+        return CopyFixed<3>(_entries.data(), indexes, count, out);
+      default:
+        return CopyFixed<kMaxWidth>(_entries.data(), indexes, count, out);
+    }
+  }
+
   std::function<void()> _seed;
   std::function<size_t(size_t)> _rand;
+  std::vector<Entry> _entries;
+  std::vector<unsigned char> _widths;
+  size_t _minWidth{kMaxWidth};
+  size_t _maxWidth{1};
 };
 
-using RandomStringGenerator = RandomStringGeneratorBase<char>;
-using RandomStringGeneratorW = RandomStringGeneratorBase<wchar_t>;
-// ... etc
+using Utf8StringGenerator = EncodedStringGeneratorBase<char>;
+using Utf16StringGenerator = EncodedStringGeneratorBase<char16_t>;
 
 int main()
 {
@@ -236,19 +4487,517 @@ int main()
     std::cout << std::endl;
   }
 
-  setlocale(LC_CTYPE, "");
-  using convert_type = std::codecvt_utf8<wchar_t>;
-  std::wstring_convert<convert_type, wchar_t> converter;
   {
-    std::cout << "Usage std::wstring as a char set and getting result to std::string." << std::endl;
-    // Remember RandomStringGenerator does not own charset only points on it
-    auto myGenerator = RandomStringGeneratorW(L"0123456789абвгдеёжзийклмнопрстуфхцчшьщъыэюя");
+    std::cout << "Collision free strings from a counter, and back from a string to the counter." << std::endl;
+    auto myGenerator = PermutationStringGenerator("0123456789abcdefghijklmnopqrstuvwxyz", 8, 42);
+    for (uint64_t i = 0; i < 10; i++) {
+      auto result = myGenerator.get<std::string>(i);
+      std::cout << result << " <-> " << myGenerator.Index(result.data()) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Weighted charset, digits are 4 times more frequent than letters." << std::endl;
+    auto myGenerator = RandomStringGenerator({{'0', 4.0}, {'1', 4.0}, {'2', 4.0}, {'a', 1.0}, {'b', 1.0}, {'c', 1.0}});
     for (auto i = 0; i < 10; i++) {
-      auto resultString = converter.to_bytes(myGenerator.get<std::wstring>(i + 1));
-      std::cout << resultString << std::endl;
+      std::cout << myGenerator.get<std::string>(i + 1) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Markov model of order 3, strings look like the corpus." << std::endl;
+    auto corpus = std::string("the quick brown fox jumps over the lazy dog, then the dog chases the fox "
+                              "through the thick forest while the other foxes watch the quiet river ");
+    auto myGenerator = MarkovStringGenerator(3);
+    myGenerator.Train(corpus.data(), corpus.size());
+    for (auto i = 0; i < 10; i++) {
+      std::cout << myGenerator.get<std::string>(20 + i) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Pattern compiled once, runs of symbols are generated directly into the result." << std::endl;
+    auto myGenerator = PatternStringGenerator("[A-Z]{3}-[0-9]{4}-[a-f0-9]{8}");
+    for (auto i = 0; i < 10; i++) {
+      std::cout << myGenerator.get<std::string>() << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Strings by a grammar, depth of expansion is bounded." << std::endl;
+    auto myGenerator = GrammarStringGenerator("<expr> ::= <term> | <expr> \"+\" <term>\n"
+                                              "<term> ::= <digit> | <term> \"*\" <digit> | \"(\" <expr> \")\"\n"
+                                              "<digit> ::= \"0\" | \"1\" | \"2\" | \"3\" | \"4\" | \"5\"\n",
+                                              6);
+    for (auto i = 0; i < 10; i++) {
+      std::cout << myGenerator.get<std::string>() << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Usage of Unicode code points as a char set and getting result directly in UTF-8." << std::endl;
+    auto myGenerator = Utf8StringGenerator(U"0123456789абвгдеёжзийклмнопрстуфхцчшьщъыэюя");
+    for (auto i = 0; i < 10; i++) {
+      std::cout << myGenerator.get<std::string>(i + 1) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "UTF-16 with surrogate pairs and UTF-32, getting result to std::u16string and std::u32string." << std::endl;
+    auto myGenerator16 = Utf16StringGenerator(U"0123456789абв\U0001F600\U0001F680");
+    auto myGenerator32 = RandomStringGenerator32(std::u32string(U"0123456789абв\U0001F600\U0001F680"));
+    for (auto i = 0; i < 10; i++) {
+      auto result16 = myGenerator16.get<std::u16string>(i + 1);
+      auto result32 = myGenerator32.get<std::u32string>(i + 1);
+      std::cout << result16.size() << " UTF-16 code units, " << result32.size() << " UTF-32 code units" << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Ranges as a charset, all of Unicode except surrogates and CJK blocks, nothing is materialized." << std::endl;
+    auto myUnicodeGenerator = RandomStringGenerator32({CharsetRange<char32_t>{U'\0', U'\uD7FF'},
+                                                       CharsetRange<char32_t>{U'\uE000', U'\U0010FFFF'}});
+    auto myCjkGenerator = RandomStringGenerator32({CharsetRange<char32_t>{U'\u3400', U'\u4DBF'},
+                                                   CharsetRange<char32_t>{U'\u4E00', U'\u9FFF'},
+                                                   CharsetRange<char32_t>{U'\uF900', U'\uFAFF'},
+                                                   CharsetRange<char32_t>{U'\U00020000', U'\U0002A6DF'},
+                                                   CharsetRange<char32_t>{U'\U0002A700', U'\U0002B73F'}});
+    for (auto *myGenerator : {&myUnicodeGenerator, &myCjkGenerator}) {
+      for (auto i = 0; i < 5; i++) {
+        for (auto symbol : myGenerator->get<std::u32string>(4)) {
+          std::cout << std::hex << "U+" << static_cast<uint32_t>(symbol) << ' ';
+        }
+        std::cout << std::dec << std::endl;
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Built-in engine, hex, base58 and base64 tokens take a lot of symbols from every 64 random bits." << std::endl;
+    auto myHexGenerator = RandomStringGenerator(std::string("0123456789abcdef"));
+    auto myBase58Generator = RandomStringGenerator(std::string("123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz"));
+    auto myBase64Generator = RandomStringGenerator(std::string("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"));
+    myHexGenerator.UseEngine(Xoshiro256(1));
+    myBase58Generator.UseEngine(Xoshiro256(2));
+    myBase64Generator.UseEngine(Xoshiro256(3));
+    for (auto i = 0; i < 5; i++) {
+      std::cout << myHexGenerator.get<std::string>(32) << ' '
+                << myBase58Generator.get<std::string>(22) << ' '
+                << myBase64Generator.get<std::string>(22) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Tiny charsets, 64 bits of the engine are 64 binary symbols or 32 DNA bases." << std::endl;
+    auto myBinaryGenerator = RandomStringGenerator(std::string("01"));
+    auto myDnaGenerator = RandomStringGenerator(std::string("ACGT"));
+    myBinaryGenerator.UseEngine(Xoshiro256(4));
+    myDnaGenerator.UseEngine(Xoshiro256(5));
+    for (auto i = 0; i < 5; i++) {
+      std::cout << myBinaryGenerator.get<std::string>(32) << ' ' << myDnaGenerator.get<std::string>(32) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Packed DNA, 2 bits per base, unpacked lazily or by blocks." << std::endl;
+    auto myGenerator = RandomStringGenerator(std::string("ACGT"));
+    myGenerator.UseEngine(Xoshiro256(6));
+    auto packed = myGenerator.GetPacked(1000);
+    std::cout << packed.Size() << " bases in " << packed.WordCount() * sizeof(uint64_t) << " bytes" << std::endl;
+    for (size_t i = 0; i < 5; i++) {
+      auto view = packed.Slice(i * 32, 32);
+      std::cout << std::string(view.begin(), view.end()) << ' ' << packed.Unpack<std::string>(i * 32 + 3, 16) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Virtual table of a billion random strings, only accessed rows are generated." << std::endl;
+    auto mySequence = RandomStringSequence("0123456789abcdefghijklmnopqrstuvwxyz", 1000000000, 12, 42);
+    for (auto index : {size_t{0}, size_t{1}, size_t{999999999}, size_t{123456789}, size_t{0}}) {
+      std::cout << index << ": " << mySequence[index] << std::endl;
+    }
+    auto rows = 0;
+    for (auto row : mySequence) {
+      if (rows++ == 3) {
+        break;
+      }
+      std::cout << row << std::endl;
+    }
+    std::cout << "chunks generated: " << mySequence.CacheMisses() << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Keyed derivation, the same user id is always the same display name." << std::endl;
+    auto myDeriver = KeyedStringDeriver("abcdefghijklmnopqrstuvwxyz", 10, 0x0123456789ABCDEFull, 0xFEDCBA9876543210ull);
+    auto ids = std::vector<uint64_t>{1, 2, 3, 1000000, 1};
+    auto names = std::string(ids.size() * 10, ' ');
+    myDeriver.Derive(ids.data(), ids.size(), names.data());
+    for (size_t i = 0; i < ids.size(); i++) {
+      std::cout << ids[i] << " -> " << names.substr(i * 10, 10) << std::endl;
+    }
+    auto email = std::string_view("user@example.com");
+    auto name = std::string(10, ' ');
+    myDeriver.Derive(&email, 1, name.data());
+    std::cout << email << " -> " << name << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Masking of records, the format is kept, the same key gives the same output, chunks can be masked apart." << std::endl;
+    auto myMasker = FormatPreservingMasker(0x5EC12E7ull);
+    std::string myRecords = "John Smith, +1 (555) 123-4567, 4111-1111-1111-1111, born 1984-03-12\n"
+                            "Anna Kowalska, +48 601 234 567, 5500-0000-0000-0004, born 1990-11-30\n";
+    std::string myWhole(myRecords.size(), '\0');
+    myMasker.Mask(myRecords.data(), &myWhole[0], myRecords.size(), 0);
+    std::string myChunked(myRecords.size(), '\0');
+    auto myHalf = myRecords.size() / 2;
+    myMasker.Mask(myRecords.data() + myHalf, &myChunked[myHalf], myRecords.size() - myHalf, myHalf);
+    myMasker.Mask(myRecords.data(), &myChunked[0], myHalf, 0);
+    std::cout << myWhole;
+    std::cout << (myWhole == myChunked ? "chunks match" : "chunks differ") << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Random strings already in sorted order, two shards of one sample." << std::endl;
+    for (size_t myShard = 0; myShard < 2; myShard++) {
+      auto myGenerator = SortedStringGenerator("abcdefghijklmnopqrstuvwxyz", 10, 6, 2024, myShard, 2);
+      std::cout << "shard " << myShard << ", " << myGenerator.Size() << " strings" << std::endl;
+      while (!myGenerator.Done()) {
+        std::cout << myGenerator.get<std::string>() << std::endl;
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Checkpoint of the built-in engine, the resumed generator continues the same stream." << std::endl;
+    auto myGenerator = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz0123456789");
+    myGenerator.UseEngine(Xoshiro256(77));
+    std::cout << myGenerator.get<std::string>(16) << std::endl;
+    auto myCheckpoint = myGenerator.SaveState();
+    auto myExpected = myGenerator.get<std::string>(16);
+    auto myResumed = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz0123456789");
+    myResumed.LoadState(myCheckpoint);
+    auto myActual = myResumed.get<std::string>(16);
+    std::cout << myActual << (myActual == myExpected ? " the same" : " different") << ", checkpoint " << myCheckpoint.size() << " bytes" << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Shards of one seed, every process takes its own part of the stream without overlaps." << std::endl;
+    for (uint64_t myShard = 0; myShard < 4; myShard++) {
+      auto myGenerator = RandomStringGenerator("0123456789abcdef");
+      myGenerator.UseEngine(Xoshiro256::ForShard(2024, myShard, 4));
+      std::cout << "shard " << myShard << ": " << myGenerator.get<std::string>(24) << std::endl;
+    }
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Lazy views, symbols go directly to the stream and strings directly to hashing, without std::string." << std::endl;
+    auto myGenerator = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz");
+    auto mySymbols = GenerateView(myGenerator, 40);
+    std::copy(mySymbols.begin(), mySymbols.end(), std::ostream_iterator<char>(std::cout));
+    std::cout << std::endl;
+    size_t myHash = 0;
+    auto myStrings = StringsView(myGenerator, 100000, 12);
+    for (auto myString : myStrings) {
+      myHash ^= std::hash<std::string_view>{}(myString);
+    }
+    std::cout << "xor of hashes of " << myStrings.size() << " strings: " << myHash << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Background generation with progress and cancellation." << std::endl;
+    auto myGenerator = RandomStringGenerator("0123456789abcdef");
+    myGenerator.UseEngine(Xoshiro256(5));
+    std::string myBig(64 << 20, '\0');
+    auto myJob = myGenerator.GenerateAsync(&myBig[0], myBig.size());
+    while (myJob.Future().wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) {
+    }
+    std::cout << "produced " << myJob.Wait() << " of " << myJob.Total() << ", begins with " << myBig.substr(0, 16) << std::endl;
+    auto myCancelled = myGenerator.GenerateAsync(&myBig[0], myBig.size());
+    myCancelled.Cancel();
+    std::cout << "cancelled job produced " << myCancelled.Wait() << " of " << myCancelled.Total() << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Prefilled ring, the background thread generates ahead and get() only copies." << std::endl;
+    auto myBase = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz0123456789");
+    myBase.UseEngine(Xoshiro256(9));
+    auto myGenerator = PrefilledStringGenerator(myBase);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (auto i = 0; i < 5; i++) {
+      std::cout << myGenerator.get<std::string>(24) << std::endl;
+    }
+    std::cout << "requests served not only from the ring: " << myGenerator.Misses() << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Short requests with the built-in engine are served from the pool, it is refilled by the bulk kernels." << std::endl;
+    auto myGenerator = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz0123456789");
+    myGenerator.UseEngine(Xoshiro256(12));
+    for (auto i = 0; i < 10000; i++) {
+      myGenerator.get<std::string>(12);
+    }
+    std::cout << myGenerator.get<std::string>(12) << ", 10001 requests, refills: " << myGenerator.RefillCount() << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Parallel generation, threads are pinned by NUMA nodes and first touch the output." << std::endl;
+    auto myTopology = NumaTopology::Detect();
+    std::cout << "NUMA nodes: " << myTopology.nodes.size() << std::endl;
+    auto myGenerator = RandomStringGenerator("0123456789abcdef");
+    myGenerator.UseEngine(Xoshiro256(48));
+    auto myOutput = myGenerator.ParallelGenerate(1 << 20, 4, AffinityPolicy::PerNode);
+    std::cout << std::string(myOutput.get(), 32) << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Output in the arena of huge pages through the allocator." << std::endl;
+    auto myArena = HugePageArena(8 << 20);
+    auto myGenerator = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz");
+    using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+    auto myString = myGenerator.get<ArenaString>(1 << 20, ArenaAllocator<char>(myArena));
+    auto myBacking = myArena.GetBacking();
+    std::cout << std::string(myString.data(), 32) << ", backing: "
+              << (myBacking == HugePageArena::Backing::HugeTlb ? "MAP_HUGETLB" : myBacking == HugePageArena::Backing::TransparentHugePages ? "MADV_HUGEPAGE" : "regular pages")
+              << ", used " << myArena.Used() << " of " << myArena.Capacity() << " bytes" << std::endl;
+    std::cout << std::endl;
+  }
+
+  {
+    std::cout << "Non-temporal stores can be forced on or off, by default they are used only for big outputs." << std::endl;
+    auto myGenerator = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz");
+    myGenerator.UseStreamingStores(StreamingStores::Always);
+    auto myString = myGenerator.get<std::string>(10000 + 7);
+    std::cout << myString.substr(0, 16) << "..." << myString.substr(myString.size() - 16) << std::endl;
+    std::cout << std::endl;
+  }
+
+#if RANDOM_STRING_GENERATOR_BENCHMARKS
+  {
+    std::cout << "Benchmark: CJK ranges are mapped arithmetically, the same shuffled charset is mapped by the table." << std::endl;
+    // Cheap rand, otherwise std::rand hides the difference of mapping.
+    auto xorshift = [state = uint64_t{88172645463325252ull}](size_t range) mutable {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      return static_cast<size_t>(((state >> 32) * range) >> 32);
+    };
+    auto contiguous = std::u32string();
+    for (auto symbol = U'\u4E00'; symbol <= U'\u9FFF'; symbol++) {
+      contiguous.push_back(symbol);
+    }
+    for (auto symbol = U'\U00020000'; symbol <= U'\U0002A6DF'; symbol++) {
+      contiguous.push_back(symbol);
+    }
+    auto shuffled = contiguous;
+    for (size_t i = shuffled.size() - 1; i > 0; i--) {
+      std::swap(shuffled[i], shuffled[xorshift(i + 1)]);
+    }
+    auto out = std::u32string(size_t{1} << 24, U' ');
+    for (auto const &name : {"ranges", "table", "ranges", "table"}) {
+      auto myGenerator = RandomStringGenerator32(name[0] == 'r' ? contiguous : shuffled, []() {}, xorshift);
+      auto start = std::chrono::steady_clock::now();
+      myGenerator.get(out.data(), out.size());
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::cout << name << ": " << out.size() / seconds / 1e6 << " M symbols/s" << std::endl;
+    }
+    std::cout << std::endl;
+  }
+  {
+    std::cout << "Benchmark: std::rand per symbol, built-in engine per symbol and built-in engine with word kernels." << std::endl;
+    auto out = std::string(size_t{1} << 26, ' ');
+    for (auto const &charset : {std::string("01"), std::string("ACGT"), std::string("0123456789abcdef"), std::string("123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz")}) {
+      for (auto const &name : {"std::rand", "engine, generic", "engine, encoding"}) {
+        // One more symbol at the end turns off the encoding detection, so the generic kernel is measured on almost the same charset.
+        auto myGenerator = RandomStringGenerator(name[0] == 'e' && name[8] == 'g' ? charset + '?' : charset);
+        if (name[0] == 'e') {
+          myGenerator.UseEngine(Xoshiro256(42));
+        }
+        auto start = std::chrono::steady_clock::now();
+        myGenerator.get(out.data(), out.size());
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << charset.size() << " symbols, " << name << ": " << out.size() / seconds / 1e6 << " M symbols/s" << std::endl;
+      }
+    }
+    std::cout << std::endl;
+  }
+  {
+    std::cout << "Benchmark: latency of get() of 32 symbols, synchronous and prefilled, requests come every 2 us." << std::endl;
+    auto myBase = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz0123456789");
+    myBase.UseEngine(Xoshiro256(3));
+    auto myPrefilled = PrefilledStringGenerator(myBase);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    char out[32];
+    for (auto const &name : {"synchronous", "prefilled"}) {
+      std::vector<double> latencies(200000);
+      for (auto &latency : latencies) {
+        auto start = std::chrono::steady_clock::now();
+        if (name[0] == 's') {
+          myBase.get(out, sizeof(out));
+        } else {
+          myPrefilled.get(out, sizeof(out));
+        }
+        auto stop = std::chrono::steady_clock::now();
+        latency = std::chrono::duration<double, std::nano>(stop - start).count();
+        while (std::chrono::steady_clock::now() - stop < std::chrono::microseconds(2)) {
+        }
+      }
+      std::sort(latencies.begin(), latencies.end());
+      std::cout << name << ": p50 " << latencies[latencies.size() / 2] << " ns, p99 " << latencies[latencies.size() * 99 / 100]
+                << " ns, p99.9 " << latencies[latencies.size() * 999 / 1000] << " ns" << std::endl;
+    }
+    std::cout << "prefilled misses: " << myPrefilled.Misses() << std::endl;
+    std::cout << std::endl;
+  }
+  {
+    std::cout << "Benchmark: requests of 12 symbols from the pool and one bulk request of the same total size." << std::endl;
+    auto myGenerator = RandomStringGenerator("abcdefghijklmnopqrstuvwxyz0123456789");
+    myGenerator.UseEngine(Xoshiro256(8));
+    auto out = std::string(size_t{12} << 22, ' ');
+    for (auto const &name : {"short requests", "bulk request"}) {
+      auto start = std::chrono::steady_clock::now();
+      if (name[0] == 's') {
+        for (size_t i = 0; i < out.size(); i += 12) {
+          myGenerator.get(&out[i], 12);
+        }
+      } else {
+        myGenerator.get(out.data(), out.size());
+      }
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      std::cout << name << ": " << out.size() / seconds / 1e6 << " M symbols/s" << std::endl;
+    }
+    std::cout << "refills: " << myGenerator.RefillCount() << std::endl;
+    std::cout << std::endl;
+  }
+  {
+    std::cout << "Benchmark: parallel generation into fresh memory and reading by node pinned threads, without and with NUMA placement." << std::endl;
+    auto myTopology = NumaTopology::Detect();
+    auto threads = static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u));
+    auto size = size_t{1} << 28;
+    for (auto const &name : {"no affinity", "per node"}) {
+      auto myGenerator = RandomStringGenerator("0123456789abcdef");
+      myGenerator.UseEngine(Xoshiro256(4));
+      auto start = std::chrono::steady_clock::now();
+      auto output = myGenerator.ParallelGenerate(size, threads, name[0] == 'n' ? AffinityPolicy::None : AffinityPolicy::PerNode);
+      auto generation = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      // Readers always use the per node split, with the placement their pages are local.
+      std::vector<uint64_t> sums(threads);
+      std::vector<std::thread> readers;
+      start = std::chrono::steady_clock::now();
+      for (size_t thread = 0; thread < threads; thread++) {
+        readers.emplace_back([&, thread]() {
+          NumaTopology::PinThisThread(myTopology.nodes[thread * myTopology.nodes.size() / threads]);
+          auto begin = size / threads * thread;
+          auto end = thread + 1 == threads ? size : begin + size / threads;
+          uint64_t sum = 0;
+          for (int pass = 0; pass < 4; pass++) {
+            for (auto i = begin; i < end; i++) {
+              sum += static_cast<unsigned char>(output[i]);
+            }
+          }
+          sums[thread] = sum;
+        });
+      }
+      for (auto &reader : readers) {
+        reader.join();
+      }
+      auto reading = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      uint64_t checksum = 0;
+      for (auto sum : sums) {
+        checksum += sum;
+      }
+      std::cout << name << ": generation " << size / generation / 1e9 << " GB/s, reading " << size * 4 / reading / 1e9
+                << " GB/s, checksum " << checksum << std::endl;
+    }
+    std::cout << std::endl;
+  }
+  {
+    std::cout << "Benchmark: big generation with and without non-temporal stores, while another thread works on a cache sized buffer." << std::endl;
+    auto out = std::string(size_t{1} << 29, ' ');
+    for (auto const &name : {"usual stores", "non-temporal stores"}) {
+      std::atomic<bool> stop{false};
+      std::atomic<uint64_t> accesses{0};
+      // Random reads of 1MB, it is fast only while the buffer stays in the cache.
+      std::thread coRunner([&]() {
+        std::vector<uint32_t> buffer(1 << 18, 1);
+        uint64_t state = 88172645463325252ull, sum = 0, count = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+          for (int i = 0; i < 4096; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            sum += buffer[state & (buffer.size() - 1)];
+          }
+          count += 4096;
+        }
+        accesses = count + (sum & 1);
+      });
+      auto myGenerator = RandomStringGenerator("0123456789abcdef");
+      myGenerator.UseEngine(Xoshiro256(50));
+      myGenerator.UseStreamingStores(name[0] == 'u' ? StreamingStores::Never : StreamingStores::Always);
+      auto start = std::chrono::steady_clock::now();
+      for (int pass = 0; pass < 4; pass++) {
+        myGenerator.get(out.data(), out.size());
+      }
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      stop = true;
+      coRunner.join();
+      std::cout << name << ": generation " << out.size() * 4 / seconds / 1e9 << " GB/s, co-running thread "
+                << accesses / seconds / 1e6 << " M reads/s" << std::endl;
+    }
+    std::cout << std::endl;
+  }
+#if !defined(_WIN32)
+  {
+    std::cout << "Benchmark: page faults and throughput of generation into regular pages and into the huge page arena." << std::endl;
+    auto size = size_t{1} << 30;
+    for (auto const &name : {"regular pages", "huge page arena"}) {
+      auto myGenerator = RandomStringGenerator("0123456789abcdef");
+      myGenerator.UseEngine(Xoshiro256(49));
+      std::unique_ptr<char[]> regular;
+      std::unique_ptr<HugePageArena> arena;
+      char *out = nullptr;
+      rusage before = {};
+      getrusage(RUSAGE_SELF, &before);
+      auto start = std::chrono::steady_clock::now();
+      if (name[0] == 'r') {
+        regular.reset(new char[size]);
+        out = regular.get();
+      } else {
+        arena.reset(new HugePageArena(size));
+        out = static_cast<char *>(arena->Allocate(size));
+      }
+      myGenerator.get(out, size);
+      auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      rusage after = {};
+      getrusage(RUSAGE_SELF, &after);
+      std::cout << name << ": " << size / seconds / 1e9 << " GB/s, minor faults " << after.ru_minflt - before.ru_minflt << std::endl;
     }
     std::cout << std::endl;
   }
+#endif
+#endif
 
   return 0;
 }